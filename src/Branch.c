@@ -5,12 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #define OUR(t) (cb->pieces[GET_PIECE(t, cb->turn)])                                     // Bitboard representing our pieces of type t
 #define THEIR(t) (cb->pieces[GET_PIECE(t, !cb->turn)])                                  // Bitboard representing their pieces of type t
 #define ALL (~cb->pieces[EMPTY_PIECE])                                                  // Bitboard of all the pieces
-#define US (OUR(Pawn) | OUR(Knight) | OUR(Bishop) | OUR(Rook) | OUR(Queen) | OUR(King)) // Bitboard of all our pieces
-#define THEM (ALL & ~US)                                                                // Bitboard of all their pieces
+#define US (cb->occupancy[cb->turn])                                                    // Bitboard of all our pieces
+#define THEM (cb->occupancy[!cb->turn])                                                 // Bitboard of all their pieces
 
 #define GET_RANK(s) (SOUTH_EDGE >> (EDGE_SIZE * (EDGE_SIZE - BitBoardGetRank(s) - 1))) // BitBoard representing the rank of a specific square
 #define ENPASSANT_RANK(c) (BitBoard) SOUTH_EDGE >> (EDGE_SIZE * ((c * 3) + 2))         // BitBoard representing the enpassant rank given a color
@@ -32,25 +33,148 @@
 #define SINGLE_PUSH(b, c) ((c == White) ? BitBoardShiftN(b) : BitBoardShiftS(b))
 #define DOUBLE_PUSH(b, c) ((c == White) ? BitBoardShiftN(BitBoardShiftN(b)) : BitBoardShiftS(BitBoardShiftS(b)))
 
-Branch BranchNew(BitBoard to, BitBoard from, Piece moved)
+Branch BranchNew(BitBoard to, BitBoard from, Piece moved, uint8_t flags)
 {
   Branch b;
   b.to = to;
   b.from = from;
   b.moved = moved;
+  b.flags = flags;
   return b;
 }
 
+// Flags of a move from and to the given squares of a branch which does not promote
+static uint8_t moveFlags(Branch *b, Square from, Square to)
+{
+  if (GET_TYPE(b->moved) == King && (from - to == 2 || to - from == 2))
+    return MOVE_CASTLE;
+  return b->flags;
+}
+
+// Which of the legal moves fillBranches generates
+typedef enum
+{
+  FILL_ALL,
+  FILL_CAPTURES, // Captures, en passant included, and promotions
+  FILL_QUIETS,   // Every other move, castling included
+  FILL_EVASIONS  // King moves, and other moves only if they take the checking piece or block its ray
+} FillMode;
+
+static int fillBranches(LookupTable l, ChessBoard *cb, Branch *b, FillMode mode);
+
 int BranchFill(LookupTable l, ChessBoard *cb, Branch *b)
+{
+  return fillBranches(l, cb, b, FILL_ALL);
+}
+
+int BranchFillCaptures(LookupTable l, ChessBoard *cb, Branch *b)
+{
+  return fillBranches(l, cb, b, FILL_CAPTURES);
+}
+
+int BranchFillQuiets(LookupTable l, ChessBoard *cb, Branch *b)
+{
+  return fillBranches(l, cb, b, FILL_QUIETS);
+}
+
+int BranchFillEvasions(LookupTable l, ChessBoard *cb, Branch *b)
+{
+  return fillBranches(l, cb, b, FILL_EVASIONS);
+}
+
+#ifdef PSEUDO_LEGAL
+/*
+ * Fills the branches with the pseudo-legal moves of the given mode: pins are not looked at, and
+ * checks only for evasions, LEGAL_AFTER_MOVE catches the moves leaving the king attacked. The
+ * attacked squares are only computed for castling, once the squares between king and rook are empty.
+ */
+static int fillBranches(LookupTable l, ChessBoard *cb, Branch *b, FillMode mode)
+{
+  int size = 0;
+  Square s;
+  BitBoard attacked, checking, checkMask, targets, moves, b1, b2, b3;
+
+  targets = (mode == FILL_CAPTURES) ? THEM : (mode == FILL_QUIETS) ? ~ALL : ~(BitBoard)EMPTY_BOARD;
+
+  // King branch
+  moves = LookupTableAttacks(l, BitBoardGetLSB(OUR(King)), King, EMPTY_BOARD) & ~US & targets;
+  b1 = (cb->castling | (ALL & OCCUPANCY_MASK)) & BACK_RANK(cb->turn);
+  if (mode != FILL_CAPTURES &&
+      ((b1 & KINGSIDE) == (KINGSIDE_CASTLING & BACK_RANK(cb->turn)) || (b1 & QUEENSIDE) == (QUEENSIDE_CASTLING & BACK_RANK(cb->turn))))
+  { // Castling, never out of check nor through an attacked square
+    attacked = ChessBoardAttacked(l, cb);
+    b1 |= attacked & ATTACK_MASK & BACK_RANK(cb->turn);
+    if (!(attacked & OUR(King)) && (b1 & KINGSIDE) == (KINGSIDE_CASTLING & BACK_RANK(cb->turn)))
+      moves |= OUR(King) << 2;
+    if (!(attacked & OUR(King)) && (b1 & QUEENSIDE) == (QUEENSIDE_CASTLING & BACK_RANK(cb->turn)))
+      moves |= OUR(King) >> 2;
+  }
+  b[size++] = BranchNew(moves, OUR(King), GET_PIECE(King, cb->turn), MOVE_NORMAL);
+
+  // Out of check the other pieces must take the checking piece or block its ray, which none can do against two
+  checkMask = ~(BitBoard)EMPTY_BOARD;
+  if (mode == FILL_EVASIONS)
+  {
+    checking = ChessBoardChecking(l, cb);
+    if (BitBoardCountBits(checking) > 1)
+      return size;
+    if (checking)
+      checkMask = checking | LookupTableGetSquaresBetween(l, BitBoardGetLSB(OUR(King)), BitBoardGetLSB(checking));
+    targets &= checkMask;
+  }
+
+  // Piece branches
+  b1 = US & ~(OUR(Pawn) | OUR(King));
+  while (b1)
+  {
+    s = BitBoardPopLSB(&b1);
+    moves = LookupTableAttacks(l, s, GET_TYPE(cb->squares[s]), ALL) & ~US & targets;
+    b[size++] = BranchNew(moves, BitBoardSetBit(EMPTY_BOARD, s), cb->squares[s], MOVE_NORMAL);
+  }
+
+  // Pawn branches
+  b1 = OUR(Pawn);
+  moves = PAWN_ATTACKS_LEFT(b1, cb->turn) & THEM & targets;
+  b[size++] = BranchNew(moves, PAWN_ATTACKS_LEFT(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
+  moves = PAWN_ATTACKS_RIGHT(b1, cb->turn) & THEM & targets;
+  b[size++] = BranchNew(moves, PAWN_ATTACKS_RIGHT(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
+  b2 = SINGLE_PUSH(b1, cb->turn) & ~ALL;
+  moves = b2 & checkMask;
+  if (mode == FILL_CAPTURES)
+    moves &= PROMOTING_RANK(cb->turn);
+  else if (mode == FILL_QUIETS)
+    moves &= ~PROMOTING_RANK(cb->turn);
+  b[size++] = BranchNew(moves, SINGLE_PUSH(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
+  moves = SINGLE_PUSH(b2 & ENPASSANT_RANK(cb->turn), cb->turn) & ~ALL & targets;
+  b[size++] = BranchNew(moves, DOUBLE_PUSH(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
+
+  // En passant branch, which answers a check by taking the checking pawn or blocking on its square
+  b3 = (cb->enPassant != EMPTY_SQUARE) ? BitBoardSetBit(EMPTY_BOARD, cb->enPassant) : EMPTY_BOARD;
+  if (mode != FILL_QUIETS && ((b3 | SINGLE_PUSH(b3, (!cb->turn))) & checkMask))
+  {
+    b2 = PAWN_ATTACKS(b3, (!cb->turn)) & OUR(Pawn);
+    if (b2 != EMPTY_BOARD)
+    {
+      b[size++] = BranchNew(b3, b2, GET_PIECE(Pawn, cb->turn), MOVE_EN_PASSANT);
+    }
+  }
+
+  return size;
+}
+#else
+// Fills the branches with the legal moves of the given mode, all of them sharing the pin and check masks
+static int fillBranches(LookupTable l, ChessBoard *cb, Branch *b, FillMode mode)
 {
   int size = 0;
   Square s;
-  BitBoard pinned, checking, attacked, checkMask, moves, b1, b2, b3;
+  BitBoard pinned, checking, attacked, checkMask, targets, moves, b1, b2, b3;
+  int checkers;
 
   attacked = ChessBoardAttacked(l, cb);
   checking = ChessBoardChecking(l, cb);
-  pinned = ChessBoardPinned(l, cb);
+  checkers = BitBoardCountBits(checking);
   checkMask = ~EMPTY_BOARD;
+  targets = (mode == FILL_CAPTURES) ? THEM : (mode == FILL_QUIETS) ? ~ALL : ~(BitBoard)EMPTY_BOARD;
   while (checking)
   {
     s = BitBoardPopLSB(&checking);
@@ -58,38 +182,50 @@ int BranchFill(LookupTable l, ChessBoard *cb, Branch *b)
   }
 
   // King branch
-  moves = LookupTableAttacks(l, BitBoardGetLSB(OUR(King)), King, EMPTY_BOARD) & ~US & ~attacked;
-  b1 = (cb->castling | (attacked & ATTACK_MASK) | (ALL & OCCUPANCY_MASK)) & BACK_RANK(cb->turn);
-  if ((b1 & KINGSIDE) == (KINGSIDE_CASTLING & BACK_RANK(cb->turn)) && (~checkMask == EMPTY_BOARD))
-    moves |= OUR(King) << 2;
-  if ((b1 & QUEENSIDE) == (QUEENSIDE_CASTLING & BACK_RANK(cb->turn)) && (~checkMask == EMPTY_BOARD))
-    moves |= OUR(King) >> 2;
-  b[size++] = BranchNew(moves, OUR(King), GET_PIECE(King, cb->turn));
+  moves = LookupTableAttacks(l, BitBoardGetLSB(OUR(King)), King, EMPTY_BOARD) & ~US & ~attacked & targets;
+  if (checkers == 0 && mode != FILL_CAPTURES)
+  { // Castling, never out of check
+    b1 = (cb->castling | (attacked & ATTACK_MASK) | (ALL & OCCUPANCY_MASK)) & BACK_RANK(cb->turn);
+    if ((b1 & KINGSIDE) == (KINGSIDE_CASTLING & BACK_RANK(cb->turn)))
+      moves |= OUR(King) << 2;
+    if ((b1 & QUEENSIDE) == (QUEENSIDE_CASTLING & BACK_RANK(cb->turn)))
+      moves |= OUR(King) >> 2;
+  }
+  b[size++] = BranchNew(moves, OUR(King), GET_PIECE(King, cb->turn), MOVE_NORMAL);
+
+  // Only the king can answer two checks at once
+  if (mode == FILL_EVASIONS && checkers > 1)
+    return size;
+  pinned = ChessBoardPinned(l, cb);
 
   // Piece branches
   b1 = US & ~(OUR(Pawn) | OUR(King));
   while (b1)
   {
     s = BitBoardPopLSB(&b1);
-    moves = LookupTableAttacks(l, s, GET_TYPE(cb->squares[s]), ALL) & ~US & checkMask;
+    moves = LookupTableAttacks(l, s, GET_TYPE(cb->squares[s]), ALL) & ~US & checkMask & targets;
     if (BitBoardSetBit(EMPTY_BOARD, s) & pinned)
     {
       moves &= LookupTableGetLineOfSight(l, BitBoardGetLSB(OUR(King)), s);
     }
-    b[size++] = BranchNew(moves, BitBoardSetBit(EMPTY_BOARD, s), cb->squares[s]);
+    b[size++] = BranchNew(moves, BitBoardSetBit(EMPTY_BOARD, s), cb->squares[s], MOVE_NORMAL);
   }
 
   // Pawn branches
   b1 = OUR(Pawn);
-  moves = PAWN_ATTACKS_LEFT(b1, cb->turn) & THEM & checkMask;
-  b[size++] = BranchNew(moves, PAWN_ATTACKS_LEFT(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn));
-  moves = PAWN_ATTACKS_RIGHT(b1, cb->turn) & THEM & checkMask;
-  b[size++] = BranchNew(moves, PAWN_ATTACKS_RIGHT(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn));
+  moves = PAWN_ATTACKS_LEFT(b1, cb->turn) & THEM & checkMask & targets;
+  b[size++] = BranchNew(moves, PAWN_ATTACKS_LEFT(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
+  moves = PAWN_ATTACKS_RIGHT(b1, cb->turn) & THEM & checkMask & targets;
+  b[size++] = BranchNew(moves, PAWN_ATTACKS_RIGHT(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
   b2 = SINGLE_PUSH(b1, cb->turn) & ~ALL;
   moves = b2 & checkMask;
-  b[size++] = BranchNew(moves, SINGLE_PUSH(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn));
-  moves = SINGLE_PUSH(b2 & ENPASSANT_RANK(cb->turn), cb->turn) & ~ALL & checkMask;
-  b[size++] = BranchNew(moves, DOUBLE_PUSH(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn));
+  if (mode == FILL_CAPTURES)
+    moves &= PROMOTING_RANK(cb->turn);
+  else if (mode == FILL_QUIETS)
+    moves &= ~PROMOTING_RANK(cb->turn);
+  b[size++] = BranchNew(moves, SINGLE_PUSH(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
+  moves = SINGLE_PUSH(b2 & ENPASSANT_RANK(cb->turn), cb->turn) & ~ALL & checkMask & targets;
+  b[size++] = BranchNew(moves, DOUBLE_PUSH(moves, (!cb->turn)), GET_PIECE(Pawn, cb->turn), MOVE_NORMAL);
 
   {
     int baseIndex = size - 4;
@@ -112,12 +248,12 @@ int BranchFill(LookupTable l, ChessBoard *cb, Branch *b)
     }
   }
 
-  // En passant branch
-  if (cb->enPassant != EMPTY_SQUARE)
+  // En passant branch, which answers a check by taking the checking pawn or blocking on its square
+  b3 = (cb->enPassant != EMPTY_SQUARE) ? BitBoardSetBit(EMPTY_BOARD, cb->enPassant) : EMPTY_BOARD;
+  if (mode != FILL_QUIETS && ((b3 | SINGLE_PUSH(b3, (!cb->turn))) & checkMask))
   {
-    b1 = PAWN_ATTACKS(BitBoardSetBit(EMPTY_BOARD, cb->enPassant), (!cb->turn)) & OUR(Pawn);
+    b1 = PAWN_ATTACKS(b3, (!cb->turn)) & OUR(Pawn);
     b2 = EMPTY_BOARD;
-    b3 = BitBoardSetBit(EMPTY_BOARD, cb->enPassant);
     while (b1)
     {
       s = BitBoardPopLSB(&b1);
@@ -130,12 +266,42 @@ int BranchFill(LookupTable l, ChessBoard *cb, Branch *b)
     }
     if (b2 != EMPTY_BOARD)
     {
-      b[size++] = BranchNew(b3, b2, GET_PIECE(Pawn, cb->turn));
+      b[size++] = BranchNew(b3, b2, GET_PIECE(Pawn, cb->turn), MOVE_EN_PASSANT);
     }
   }
 
   return size;
 }
+#endif
+
+int BranchFilterLegal(LookupTable l, ChessBoard *cb, Move *moves, int size)
+{
+#ifdef PSEUDO_LEGAL
+  int legal = 0;
+  for (int i = 0; i < size; i++)
+  {
+    Undo undo;
+    ChessBoardMakeMove(cb, moves[i], &undo);
+    if (LEGAL_AFTER_MOVE(l, cb))
+      moves[legal++] = moves[i];
+    ChessBoardUnmakeMove(cb, &undo);
+  }
+  return legal;
+#else
+  (void)l;
+  (void)cb;
+  (void)moves;
+  return size;
+#endif
+}
+
+int BranchLegalMoves(LookupTable l, ChessBoard *cb, MoveList *list)
+{
+  Branch b[BRANCHES_SIZE];
+  int size = BranchFill(l, cb, b);
+  list->size = BranchFilterLegal(l, cb, list->moves, BranchExtract(b, size, list->moves));
+  return list->size;
+}
 
 int BranchCount(Branch *b, int size)
 {
@@ -162,7 +328,6 @@ int BranchCount(Branch *b, int size)
 
 int BranchExtract(Branch *b, int size, Move *moves)
 {
-  Move m;
   int index = 0;
   for (int i = 0; i < size; i++)
   {
@@ -178,32 +343,94 @@ int BranchExtract(Branch *b, int size, Move *moves)
 
     for (int j = 0; j < max; j++)
     {
-      m.from = BitBoardPopLSB(&fromCopy);
-      m.to = BitBoardPopLSB(&toCopy);
-      m.moved = b[i].moved;
+      Square from = BitBoardPopLSB(&fromCopy);
+      Square to = BitBoardPopLSB(&toCopy);
       if (offset > 0)
-        fromCopy = BitBoardSetBit(fromCopy, m.from);
+        fromCopy = BitBoardSetBit(fromCopy, from);
       else if (offset < 0)
-        toCopy = BitBoardSetBit(toCopy, m.to);
-      Color c = GET_COLOR(m.moved);
-      Type t = GET_TYPE(m.moved);
-      int promotion = (t == Pawn) && (BitBoardSetBit(EMPTY_BOARD, m.to) & PROMOTING_RANK(c));
-      if (promotion)
-        m.moved = GET_PIECE(Knight, c);
+        toCopy = BitBoardSetBit(toCopy, to);
+      Color c = GET_COLOR(b[i].moved);
+      Type t = GET_TYPE(b[i].moved);
+      int promotion = (t == Pawn) && (BitBoardSetBit(EMPTY_BOARD, to) & PROMOTING_RANK(c));
 
       if (promotion)
       {
         for (Type tt = Knight; tt <= Queen; tt++)
-        {
-          m.moved = GET_PIECE(tt, c);
-          moves[index++] = m;
-        }
+          moves[index++] = MOVE_NEW(from, to, MOVE_PROMOTION_TO(tt));
       }
       else
       {
-        moves[index++] = m;
+        moves[index++] = MOVE_NEW(from, to, moveFlags(&b[i], from, to));
       }
     }
   }
   return index;
-}
\ No newline at end of file
+}
+
+// Extracts the moves whose destination is in pieceTargets, or in pawnTargets for pawn moves
+static int extractTargets(Branch *b, int size, Move *moves, BitBoard pieceTargets, BitBoard pawnTargets)
+{
+  int index = 0;
+  for (int i = 0; i < size; i++)
+  {
+    BitBoard targets = (GET_TYPE(b[i].moved) == Pawn) ? pawnTargets : pieceTargets;
+    if (BitBoardCountBits(b[i].from) <= 1 || BitBoardCountBits(b[i].to) <= 1)
+    { // Every destination pairs with every origin, so the destinations can be masked
+      Branch masked = BranchNew(b[i].to & targets, b[i].from, b[i].moved, b[i].flags);
+      index += BranchExtract(&masked, 1, moves + index);
+    }
+    else
+    { // Pawn branches pair their n-th origin with their n-th destination, filter after pairing
+      Move pawnMoves[4 * EDGE_SIZE];
+      int pawnSize = BranchExtract(&b[i], 1, pawnMoves);
+      for (int j = 0; j < pawnSize; j++)
+      {
+        if (BitBoardSetBit(EMPTY_BOARD, MOVE_TO(pawnMoves[j])) & targets)
+          moves[index++] = pawnMoves[j];
+      }
+    }
+  }
+  return index;
+}
+
+int BranchExtractTactical(ChessBoard *cb, Branch *b, int size, Move *moves)
+{
+  BitBoard enPassant = (cb->enPassant != EMPTY_SQUARE) ? BitBoardSetBit(EMPTY_BOARD, cb->enPassant) : EMPTY_BOARD;
+  return extractTargets(b, size, moves, THEM, THEM | enPassant | PROMOTING_RANK(cb->turn));
+}
+
+int BranchExtractQuiet(ChessBoard *cb, Branch *b, int size, Move *moves)
+{
+  BitBoard enPassant = (cb->enPassant != EMPTY_SQUARE) ? BitBoardSetBit(EMPTY_BOARD, cb->enPassant) : EMPTY_BOARD;
+  return extractTargets(b, size, moves, ~THEM, ~(THEM | enPassant | PROMOTING_RANK(cb->turn)));
+}
+
+bool BranchContains(Branch *b, int size, Move m)
+{
+  BitBoard from = BitBoardSetBit(EMPTY_BOARD, MOVE_FROM(m));
+  BitBoard to = BitBoardSetBit(EMPTY_BOARD, MOVE_TO(m));
+  for (int i = 0; i < size; i++)
+  {
+    if (!(b[i].from & from) || !(b[i].to & to))
+      continue;
+
+    // Promotions are stored as pawn branches and extracted once per promotion piece
+    Piece moved = b[i].moved;
+    if (GET_TYPE(moved) == Pawn && (to & PROMOTING_RANK(GET_COLOR(moved))))
+    {
+      if (!MOVE_IS_PROMOTION(m))
+        continue;
+    }
+    else if (MOVE_FLAGS(m) != moveFlags(&b[i], MOVE_FROM(m), MOVE_TO(m)))
+      continue;
+
+    int x = BitBoardCountBits(b[i].to);
+    int y = BitBoardCountBits(b[i].from);
+    if (x == 1 || y == 1)
+      return true;
+    // The n-th origin pairs with the n-th destination
+    if (BitBoardCountBits(b[i].to & (to - 1)) == BitBoardCountBits(b[i].from & (from - 1)))
+      return true;
+  }
+  return false;
+}
@@ -1,28 +1,43 @@
 #ifndef BRANCH_H
 #define BRANCH_H
 
+#include <stdbool.h>
+
 #include "BitBoard.h"
 #include "LookupTable.h"
 #include "ChessBoard.h"
 
 #define BRANCHES_SIZE 20 // Assumes only regular chess positions will be given
 
+/*
+ * Built with PSEUDO_LEGAL, the BranchFill functions skip the check and pin masks and may give
+ * moves leaving the king attacked, so every move is checked once played: it is taken back and
+ * skipped if LEGAL_AFTER_MOVE is false. Otherwise every move given is legal and the check is free.
+ */
+#ifdef PSEUDO_LEGAL
+#define LEGAL_AFTER_MOVE(l, cb) (!ChessBoardLeftInCheck(l, cb))
+#else
+#define LEGAL_AFTER_MOVE(l, cb) true
+#endif
+
 /*
  * A branch represents a mapping between a set of from squares and a set
  * of to squares for a given piece. It implicity stores the legal moves
- * for that piece.
+ * for that piece. The flags are given to each of its moves, except for
+ * promotions and castling which are told apart when extracting.
  */
 typedef struct
 {
   BitBoard to;
   BitBoard from;
   Piece moved;
+  uint8_t flags;
 } Branch;
 
 /*
- * Creates a new branch with the given to, from, and moved values
+ * Creates a new branch with the given to, from, moved and flags values
  */
-Branch BranchNew(BitBoard to, BitBoard from, Piece moved);
+Branch BranchNew(BitBoard to, BitBoard from, Piece moved, uint8_t flags);
 
 /*
  * Given an array of empty branches and a chess position, fill each branch with
@@ -35,9 +50,40 @@ Branch BranchNew(BitBoard to, BitBoard from, Piece moved);
  */
 int BranchFill(LookupTable l, ChessBoard *cb, Branch *b);
 
+/*
+ * Same as BranchFill, but only fills the branches with captures (including en passant) and
+ * promotions. Used by quiescence search.
+ */
+int BranchFillCaptures(LookupTable l, ChessBoard *cb, Branch *b);
+
+/*
+ * Same as BranchFill, but only fills the branches with the moves BranchFillCaptures leaves:
+ * non-capturing moves that don't promote, castling included.
+ */
+int BranchFillQuiets(LookupTable l, ChessBoard *cb, Branch *b);
+
+/*
+ * Same as BranchFill, meant for positions in check: the other pieces only get the moves taking
+ * the checking piece or blocking its ray, and in double check only the king branch is filled.
+ * Gives every legal move in any position, in check or not.
+ */
+int BranchFillEvasions(LookupTable l, ChessBoard *cb, Branch *b);
+
+/*
+ * Removes the moves leaving the king attacked from the given moves, returning how many remain.
+ * Only needed when built with PSEUDO_LEGAL, the moves are kept as they are otherwise.
+ */
+int BranchFilterLegal(LookupTable l, ChessBoard *cb, Move *moves, int size);
+
+/*
+ * Fills the list with the legal moves of the position, leaving their scores unset. Returns how
+ * many there are.
+ */
+int BranchLegalMoves(LookupTable l, ChessBoard *cb, MoveList *list);
+
 /*
  * Given an array of branches and the size of that array, return the toal number
- * of moves in all the branches.
+ * of moves in all the branches. Built with PSEUDO_LEGAL, this counts pseudo-legal moves.
  */
 int BranchCount(Branch *b, int size);
 
@@ -48,4 +94,21 @@ int BranchCount(Branch *b, int size);
  */
 int BranchExtract(Branch *b, int size, Move *moves);
 
+/*
+ * Same as BranchExtract, but only extracts the tactical moves: captures (including en passant)
+ * and promotions.
+ */
+int BranchExtractTactical(ChessBoard *cb, Branch *b, int size, Move *moves);
+
+/*
+ * Same as BranchExtract, but only extracts the quiet moves, the ones BranchExtractTactical leaves.
+ */
+int BranchExtractQuiet(ChessBoard *cb, Branch *b, int size, Move *moves);
+
+/*
+ * Returns true if the move is one of the moves stored in the branches. Used to check that a
+ * move from another position, e.g. from the dictionary, is legal here.
+ */
+bool BranchContains(Branch *b, int size, Move m);
+
 #endif
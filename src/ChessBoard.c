@@ -6,14 +6,14 @@
 #include "BitBoard.h"
 #include "LookupTable.h"
 #include "ChessBoard.h"
+#include "Zobrist.h"
 
 #define OUR(t) (cb->pieces[GET_PIECE(t, cb->turn)])                                     // Bitboard representing our pieces of type t
 #define THEIR(t) (cb->pieces[GET_PIECE(t, !cb->turn)])                                  // Bitboard representing their pieces of type t
 #define ALL (~cb->pieces[EMPTY_PIECE])                                                  // Bitboard of all the pieces
-#define US (OUR(Pawn) | OUR(Knight) | OUR(Bishop) | OUR(Rook) | OUR(Queen) | OUR(King)) // Bitboard of all our pieces
-#define THEM (ALL & ~US)                                                                // Bitboard of all their pieces
+#define US (cb->occupancy[cb->turn])                                                    // Bitboard of all our pieces
+#define THEM (cb->occupancy[!cb->turn])                                                 // Bitboard of all their pieces
 
-#define GET_RANK(s) (SOUTH_EDGE >> (EDGE_SIZE * (EDGE_SIZE - BitBoardGetRank(s) - 1))) // BitBoard representing the rank of a specific square
 #define BACK_RANK(c) (BitBoard)((c == White) ? SOUTH_EDGE : NORTH_EDGE)                // BitBoard representing the back rank given a color
 
 // Masks used for castling
@@ -27,6 +27,9 @@ static Color getColorFromASCII(char asciiColor);
 static char getASCIIFromPiece(Piece p);
 static Piece getPieceFromASCII(char asciiPiece);
 static void addPiece(ChessBoard *cb, Square s, Piece replacement);
+static void checkHash(ChessBoard *cb);
+static void recordMove(ChessBoard *cb, Move m, uint64_t hash);
+static void computePins(LookupTable l, ChessBoard *cb);
 
 // Assumes FEN and depth is valid
 ChessBoard ChessBoardNew(char *fen, int depth)
@@ -34,7 +37,8 @@ ChessBoard ChessBoardNew(char *fen, int depth)
   ChessBoard cb;
   memset(&cb, 0, sizeof(ChessBoard));
   cb.moves_completed = 0;
-  memset(cb.movelist, 0, sizeof(Move) * MOVELIST_SIZE);
+  cb.history = NULL;
+  cb.enPassant = EMPTY_SQUARE;
 
   // Parse pieces and squares
   for (Square s = 0; s < BOARD_SIZE && *fen; fen++)
@@ -55,6 +59,7 @@ ChessBoard ChessBoardNew(char *fen, int depth)
     {
       Piece p = getPieceFromASCII(*fen);
       cb.pieces[p] |= BitBoardSetBit(EMPTY_BOARD, s);
+      cb.occupancy[GET_COLOR(p)] |= BitBoardSetBit(EMPTY_BOARD, s);
       cb.squares[s] = p;
       s++;
     }
@@ -91,7 +96,16 @@ ChessBoard ChessBoardNew(char *fen, int depth)
     int rank = EDGE_SIZE - (*fen - '0');
     cb.enPassant = rank * EDGE_SIZE + file;
   }
+  fen++;
+
+  // Parse the halfmove clock, if the FEN has move counters
+  if (*fen == ' ')
+  {
+    cb.halfmove_clock = atoi(fen + 1);
+  }
 
+  init_zobrist_keys();
+  cb.hash = get_zobrist_hash(&cb, &zobrist_keys);
   return cb;
 }
 
@@ -121,52 +135,220 @@ static Color getColorFromASCII(char asciiColor)
   return (asciiColor == 'w') ? White : Black;
 }
 
+void ChessBoardCopy(ChessBoard *copy, GameHistory *history, ChessBoard *cb)
+{
+  memcpy(copy, cb, sizeof(ChessBoard));
+  if (cb->history != NULL)
+  {
+    memcpy(history->moves, cb->history->moves, cb->moves_completed * sizeof(Move));
+    memcpy(history->hashes, cb->history->hashes, cb->moves_completed * sizeof(uint64_t));
+  }
+  else
+  {
+    memset(history->moves, 0, cb->moves_completed * sizeof(Move));
+    memset(history->hashes, 0, cb->moves_completed * sizeof(uint64_t));
+  }
+  copy->history = history;
+}
+
 // Given an old board and a new board, copy the old board and play the move on the new board
 void ChessBoardPlayMove(ChessBoard *new, ChessBoard *old, Move m)
 {
+  Undo undo;
   memcpy(new, old, sizeof(ChessBoard));
-  int offset = m.from - m.to;
-  new->enPassant = EMPTY_SQUARE;
-  new->castling &= ~(BitBoardSetBit(EMPTY_BOARD, m.from) | BitBoardSetBit(EMPTY_BOARD, m.to));
-  
-  int pieceType = GET_TYPE(new->squares[m.from]);
-  addPiece(new, m.from, EMPTY_PIECE);
-  if (GET_RANK(m.to) == BACK_RANK(!new->turn) && pieceType == Pawn)
-  { // Promotion
-    addPiece(new, m.to, GET_PIECE(Queen, new->turn));
-  }else{
-    addPiece(new, m.to, m.moved);
+  ChessBoardMakeMove(new, m, &undo);
+}
+
+void ChessBoardMakeMove(ChessBoard *cb, Move m, Undo *undo)
+{
+  Square from = MOVE_FROM(m);
+  Square to = MOVE_TO(m);
+  int offset = from - to;
+  undo->move = m;
+  undo->moving = cb->squares[from];
+  undo->captured = cb->squares[to];
+  undo->capturedOn = to;
+  undo->enPassant = cb->enPassant;
+  undo->castling = cb->castling;
+  undo->hash = cb->hash;
+  undo->halfmoveClock = cb->halfmove_clock;
+  undo->checkInfo = cb->checkInfo;
+  cb->checkInfo.valid = 0;
+
+  if (cb->enPassant != EMPTY_SQUARE)
+  {
+    cb->hash ^= zobrist_keys.en_passant_values[cb->enPassant];
+  }
+  cb->enPassant = EMPTY_SQUARE;
+  cb->castling &= ~(BitBoardSetBit(EMPTY_BOARD, from) | BitBoardSetBit(EMPTY_BOARD, to));
+  if (cb->castling != undo->castling)
+  {
+    cb->hash ^= zobrist_castling(&zobrist_keys, undo->castling) ^ zobrist_castling(&zobrist_keys, cb->castling);
   }
 
-  new->movelist[new->moves_completed++] = m;
-  if (GET_TYPE(m.moved) == Pawn)
+  addPiece(cb, from, EMPTY_PIECE);
+  addPiece(cb, to, MOVE_IS_PROMOTION(m) ? GET_PIECE(MOVE_PROMOTED(m), cb->turn) : undo->moving);
+
+  recordMove(cb, m, undo->hash);
+  cb->halfmove_clock = (GET_TYPE(undo->moving) == Pawn || undo->captured != EMPTY_PIECE) ? 0 : cb->halfmove_clock + 1;
+  if (GET_TYPE(undo->moving) == Pawn && ((offset == 16) || (offset == -16)))
+  { // Double push
+    cb->enPassant = from - (offset / 2);
+    cb->hash ^= zobrist_keys.en_passant_values[cb->enPassant];
+  }
+  else if (MOVE_FLAGS(m) == MOVE_EN_PASSANT)
+  {
+    undo->capturedOn = to + (cb->turn ? -8 : 8);
+    undo->captured = cb->squares[undo->capturedOn];
+    addPiece(cb, undo->capturedOn, EMPTY_PIECE);
+  }
+  else if (MOVE_FLAGS(m) == MOVE_CASTLE)
   {
-    if ((offset == 16) || (offset == -16))
-    { // Double push
-      new->enPassant = m.from - (offset / 2);
+    if (offset == 2)
+    { // Queenside castling
+      addPiece(cb, to - 2, EMPTY_PIECE);
+      addPiece(cb, to + 1, GET_PIECE(Rook, cb->turn));
     }
-    else if (m.to == old->enPassant)
-    { // Enpassant
-      addPiece(new, m.to + (new->turn ? -8 : 8), EMPTY_PIECE);
+    else
+    { // Kingside castling
+      addPiece(cb, to + 1, EMPTY_PIECE);
+      addPiece(cb, to - 1, GET_PIECE(Rook, cb->turn));
     }
-    
   }
-  else if (GET_TYPE(m.moved) == King)
+
+  cb->turn = !cb->turn;
+  cb->hash ^= zobrist_keys.black_to_move_value;
+  cb->depth--;
+  checkHash(cb);
+}
+
+void ChessBoardUnmakeMove(ChessBoard *cb, Undo *undo)
+{
+  Square from = MOVE_FROM(undo->move);
+  Square to = MOVE_TO(undo->move);
+  cb->turn = !cb->turn;
+  cb->depth++;
+  cb->moves_completed--;
+
+  if (MOVE_FLAGS(undo->move) == MOVE_CASTLE)
   {
-    if (offset == 2)
+    if (from - to == 2)
     { // Queenside castling
-      addPiece(new, m.to - 2, EMPTY_PIECE);
-      addPiece(new, m.to + 1, GET_PIECE(Rook, new->turn));
+      addPiece(cb, to + 1, EMPTY_PIECE);
+      addPiece(cb, to - 2, GET_PIECE(Rook, cb->turn));
     }
-    else if (offset == -2)
+    else
     { // Kingside castling
-      addPiece(new, m.to + 1, EMPTY_PIECE);
-      addPiece(new, m.to - 1, GET_PIECE(Rook, new->turn));
+      addPiece(cb, to - 1, EMPTY_PIECE);
+      addPiece(cb, to + 1, GET_PIECE(Rook, cb->turn));
+    }
+  }
+
+  addPiece(cb, to, EMPTY_PIECE);
+  if (undo->captured != EMPTY_PIECE)
+  {
+    addPiece(cb, undo->capturedOn, undo->captured);
+  }
+  addPiece(cb, from, undo->moving);
+
+  cb->enPassant = undo->enPassant;
+  cb->castling = undo->castling;
+  cb->hash = undo->hash;
+  cb->halfmove_clock = undo->halfmoveClock;
+  cb->checkInfo = undo->checkInfo;
+  checkHash(cb);
+}
+
+void ChessBoardMakeNullMove(ChessBoard *cb, Undo *undo)
+{
+  undo->move = MOVE_NULL;
+  undo->moving = EMPTY_PIECE;
+  undo->captured = EMPTY_PIECE;
+  undo->capturedOn = EMPTY_SQUARE;
+  undo->enPassant = cb->enPassant;
+  undo->castling = cb->castling;
+  undo->hash = cb->hash;
+  undo->halfmoveClock = cb->halfmove_clock;
+  undo->checkInfo = cb->checkInfo;
+  cb->checkInfo.valid = 0;
+
+  if (cb->enPassant != EMPTY_SQUARE)
+  {
+    cb->hash ^= zobrist_keys.en_passant_values[cb->enPassant];
+  }
+  cb->enPassant = EMPTY_SQUARE;
+  recordMove(cb, undo->move, undo->hash);
+  cb->halfmove_clock = 0; // A position reached by passing is no repetition of one reached by moves
+  cb->turn = !cb->turn;
+  cb->hash ^= zobrist_keys.black_to_move_value;
+  cb->depth--;
+  checkHash(cb);
+}
+
+void ChessBoardUnmakeNullMove(ChessBoard *cb, Undo *undo)
+{
+  cb->turn = !cb->turn;
+  cb->depth++;
+  cb->moves_completed--;
+  cb->halfmove_clock = undo->halfmoveClock;
+  cb->enPassant = undo->enPassant;
+  cb->hash = undo->hash;
+  cb->checkInfo = undo->checkInfo;
+}
+
+int ChessBoardRepetitions(ChessBoard *cb)
+{
+  int oldest = cb->moves_completed - cb->halfmove_clock;
+  int repetitions = 0;
+  // The same side is to move every other ply, and it takes at least four plies to come back
+  if (cb->history == NULL)
+    return 0;
+  for (int i = cb->moves_completed - 4; i >= 0 && i >= oldest; i -= 2)
+  {
+    if (cb->history->hashes[i] == cb->hash)
+    {
+      repetitions++;
+    }
+  }
+  return repetitions;
+}
+
+bool ChessBoardIsNullMove(Move m)
+{
+  return MOVE_FROM(m) == MOVE_TO(m);
+}
+
+// Counts the move, and appends it with the hash of the position it was played from to the history if there is one
+static void recordMove(ChessBoard *cb, Move m, uint64_t hash)
+{
+  if (cb->history != NULL)
+  {
+    if (cb->moves_completed >= MOVELIST_SIZE)
+    { // The search stops short of the limit, only a game this long gets here
+      fprintf(stderr, "Move list full after %d moves\n", MOVELIST_SIZE);
+      exit(1);
     }
+    cb->history->hashes[cb->moves_completed] = hash;
+    cb->history->moves[cb->moves_completed] = m;
   }
+  cb->moves_completed++;
+}
+
+// With ZOBRIST_DEBUG defined, checks the hash kept up to date against a full recomputation
+static void checkHash(ChessBoard *cb)
+{
+#ifdef ZOBRIST_DEBUG
+  if (cb->hash != get_zobrist_hash(cb, &zobrist_keys))
+  {
+    ChessBoardPrintBoard(*cb);
+    ChessBoardPrintMovelist(*cb);
 
-  new->turn = !new->turn;
-  new->depth--;
+    fprintf(stderr, "Incremental Zobrist hash differs from the recomputed one\n");
+    exit(EXIT_FAILURE);
+  }
+#else
+  (void)cb;
+#endif
 }
 
 // Adds a piece to a chessboard
@@ -177,6 +359,16 @@ static void addPiece(ChessBoard *cb, Square s, Piece replacement)
   cb->squares[s] = replacement;
   cb->pieces[replacement] |= b;
   cb->pieces[captured] &= ~b;
+  if (captured != EMPTY_PIECE)
+  {
+    cb->occupancy[GET_COLOR(captured)] &= ~b;
+    cb->hash ^= zobrist_keys.piece_pos_values[s][captured];
+  }
+  if (replacement != EMPTY_PIECE)
+  {
+    cb->occupancy[GET_COLOR(replacement)] |= b;
+    cb->hash ^= zobrist_keys.piece_pos_values[s][replacement];
+  }
 }
 
 void ChessBoardPrintBoard(ChessBoard cb)
@@ -196,34 +388,44 @@ void ChessBoardPrintBoard(ChessBoard cb)
 
 void ChessBoardPrintMove(Move m, long nodes)
 {
-  printf("%c%d%c%d: %ld\n", 'a' + (m.from % EDGE_SIZE), EDGE_SIZE - (m.from / EDGE_SIZE), 'a' + (m.to % EDGE_SIZE), EDGE_SIZE - (m.to / EDGE_SIZE), nodes);
+  Square from = MOVE_FROM(m);
+  Square to = MOVE_TO(m);
+  printf("%c%d%c%d: %ld\n", 'a' + (from % EDGE_SIZE), EDGE_SIZE - (from / EDGE_SIZE), 'a' + (to % EDGE_SIZE), EDGE_SIZE - (to / EDGE_SIZE), nodes);
 }
 
 
 BitBoard ChessBoardChecking(LookupTable l, ChessBoard *cb)
 {
-  Square ourKing = BitBoardGetLSB(OUR(King));
-  BitBoard checking = (PAWN_ATTACKS(OUR(King), cb->turn) & THEIR(Pawn)) |
-                      (LookupTableAttacks(l, ourKing, Knight, EMPTY_BOARD) & THEIR(Knight));
-  BitBoard candidates = (LookupTableAttacks(l, ourKing, Bishop, THEM) & (THEIR(Bishop) | THEIR(Queen))) |
-                        (LookupTableAttacks(l, ourKing, Rook, THEM) & (THEIR(Rook) | THEIR(Queen)));
-
-  while (candidates)
-  {
-    Square s = BitBoardPopLSB(&candidates);
-    BitBoard b = LookupTableGetSquaresBetween(l, ourKing, s) & ALL & ~THEM;
-    if (b == EMPTY_BOARD)
-    {
-      checking |= BitBoardSetBit(EMPTY_BOARD, s);
-    }
-  }
+  if (!(cb->checkInfo.valid & CHECK_INFO_PINS))
+    computePins(l, cb);
+  return cb->checkInfo.checking;
+}
 
-  return checking;
+bool ChessBoardLeftInCheck(LookupTable l, ChessBoard *cb)
+{
+  // The side to move attacks the king of the side that just moved
+  BitBoard theirKing = THEIR(King);
+  Square s = BitBoardGetLSB(theirKing);
+  return (PAWN_ATTACKS(theirKing, !cb->turn) & OUR(Pawn)) ||
+         (LookupTableAttacks(l, s, Knight, EMPTY_BOARD) & OUR(Knight)) ||
+         (LookupTableAttacks(l, s, King, EMPTY_BOARD) & OUR(King)) ||
+         (LookupTableAttacks(l, s, Bishop, ALL) & (OUR(Bishop) | OUR(Queen))) ||
+         (LookupTableAttacks(l, s, Rook, ALL) & (OUR(Rook) | OUR(Queen)));
 }
 
 BitBoard ChessBoardPinned(LookupTable l, ChessBoard *cb)
+{
+  if (!(cb->checkInfo.valid & CHECK_INFO_PINS))
+    computePins(l, cb);
+  return cb->checkInfo.pinned;
+}
+
+// Their sliders seeing our king through our pieces give check with none in between, pin a lone one
+static void computePins(LookupTable l, ChessBoard *cb)
 {
   Square ourKing = BitBoardGetLSB(OUR(King));
+  BitBoard checking = (PAWN_ATTACKS(OUR(King), cb->turn) & THEIR(Pawn)) |
+                      (LookupTableAttacks(l, ourKing, Knight, EMPTY_BOARD) & THEIR(Knight));
   BitBoard candidates = (LookupTableAttacks(l, ourKing, Bishop, THEM) & (THEIR(Bishop) | THEIR(Queen))) |
                         (LookupTableAttacks(l, ourKing, Rook, THEM) & (THEIR(Rook) | THEIR(Queen)));
   BitBoard pinned = EMPTY_BOARD;
@@ -232,17 +434,26 @@ BitBoard ChessBoardPinned(LookupTable l, ChessBoard *cb)
   {
     Square s = BitBoardPopLSB(&candidates);
     BitBoard b = LookupTableGetSquaresBetween(l, ourKing, s) & ALL & ~THEM;
-    if (b != EMPTY_BOARD && (b & (b - 1)) == EMPTY_BOARD)
+    if (b == EMPTY_BOARD)
+    {
+      checking |= BitBoardSetBit(EMPTY_BOARD, s);
+    }
+    else if ((b & (b - 1)) == EMPTY_BOARD)
     {
       pinned |= b;
     }
   }
 
-  return pinned;
+  cb->checkInfo.checking = checking;
+  cb->checkInfo.pinned = pinned;
+  cb->checkInfo.valid |= CHECK_INFO_PINS;
 }
 
 BitBoard ChessBoardAttacked(LookupTable l, ChessBoard *cb)
 {
+  if (cb->checkInfo.valid & CHECK_INFO_ATTACKED)
+    return cb->checkInfo.attacked;
+
   BitBoard attacked, b;
   BitBoard occupancies = ALL & ~OUR(King);
 
@@ -260,12 +471,14 @@ BitBoard ChessBoardAttacked(LookupTable l, ChessBoard *cb)
     }
     attacked |= LookupTableAttacks(l, s, GET_TYPE(cb->squares[s]), occupancies);
   }
+  cb->checkInfo.attacked = attacked;
+  cb->checkInfo.valid |= CHECK_INFO_ATTACKED;
   return attacked;
 }
 
 void ChessBoardPrintMovelist(ChessBoard cb){
-  for (int i = 0; i < cb.moves_completed; i++){
-    Move m = cb.movelist[i];
+  for (int i = 0; cb.history != NULL && i < cb.moves_completed; i++){
+    Move m = cb.history->moves[i];
     ChessBoardPrintMove(m, 0);
   }
 
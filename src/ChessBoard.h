@@ -1,8 +1,11 @@
 #ifndef CHESSBOARD_H
 #define CHESSBOARD_H
 
+#include <stdbool.h>
+
 #define MOVES_SIZE 218
-#define MOVELIST_SIZE 300
+#define MOVELIST_SIZE 1024 // Plies a game history can hold, the search included
+#define FIFTY_MOVE_PLIES 100 // Halfmove clock at which the game is drawn
 #define PIECE_SIZE 12
 #define EMPTY_PIECE 12
 #define GET_PIECE(t, c) ((t << 1) | c) // Get the piece given a type and color
@@ -11,15 +14,65 @@
 
 typedef uint8_t Piece; // 0 = White Pawn, 1 = Black Pawn, 2 = White Knight, 3 = Black Knight, etc.
 
+// Kinds of moves, stored in the top bits of a move. Promotions are MOVE_PROMOTION plus the piece type
+// promoted to minus Knight, so that every kind fits in 4 bits.
+#define MOVE_NORMAL 0
+#define MOVE_CASTLE 1
+#define MOVE_EN_PASSANT 2
+#define MOVE_PROMOTION 4
+
+#define MOVE_NULL 0 // From and to the same square, no legal move looks like it
+#define MOVE_NEW(from, to, flags) ((Move)((from) | ((to) << 6) | ((flags) << 12)))
+#define MOVE_FROM(m) ((Square)((m) & 0x3F))
+#define MOVE_TO(m) ((Square)(((m) >> 6) & 0x3F))
+#define MOVE_FLAGS(m) ((m) >> 12)
+#define MOVE_IS_PROMOTION(m) (MOVE_FLAGS(m) & MOVE_PROMOTION)
+#define MOVE_PROMOTED(m) ((Type)(Knight + (MOVE_FLAGS(m) & 0x3))) // Type promoted to, for promotions only
+#define MOVE_PROMOTION_TO(t) (MOVE_PROMOTION | ((t) - Knight))     // Flags of a promotion to type t
+
+/*
+ * Representation of a move on a chess board, packed in 16 bits: from square in bits 0-5,
+ * to square in bits 6-11 and its kind in bits 12-15. The piece moved is left to the board.
+ */
+typedef uint16_t Move;
+
+/*
+ * A list of moves, each with a slot for its ordering score
+ */
+typedef struct
+{
+  Move moves[MOVES_SIZE];
+  int scores[MOVES_SIZE];
+  int size;
+} MoveList;
+
+// Bits of CheckInfo.valid, telling which of its sets are up to date
+#define CHECK_INFO_PINS 1     // checking and pinned, found by the same scan of the sliders
+#define CHECK_INFO_ATTACKED 2 // attacked
+
 /*
- * Representation of a move on a chess board
+ * Sets of squares about the safety of the king of the side to move, computed the first time
+ * one is asked for and kept until a move is played, so that the move generator, the search
+ * and the game loop share one computation per position
  */
 typedef struct
 {
-  Square to;
-  Square from;
-  Piece moved;
-} Move;
+  BitBoard checking; // Their pieces giving check
+  BitBoard pinned;   // Our pieces pinned to our king
+  BitBoard attacked; // Squares their pieces attack, seen through our king
+  uint8_t valid;
+} CheckInfo;
+
+/*
+ * Moves played on a board, with the hash of the position each was played from for repetitions.
+ * Kept out of the board so that copying a board stays cheap: copies share the history of the
+ * original, a board searched by several threads needs ChessBoardCopy to get its own.
+ */
+typedef struct
+{
+  Move moves[MOVELIST_SIZE];
+  uint64_t hashes[MOVELIST_SIZE];
+} GameHistory;
 
 /*
  * Representation of a chess board. Note that castling rights are representated as a set of
@@ -29,15 +82,35 @@ typedef struct
 typedef struct
 {
   BitBoard pieces[PIECE_SIZE + 1]; // A set of squares for each piece, including empty pieces
+  BitBoard occupancy[2];           // A set of squares for each color, the union of its pieces
   Piece squares[BOARD_SIZE];       // A piece for each square, including empty pieces
   Color turn;
   Square enPassant;
   BitBoard castling;
-  Move movelist[MOVELIST_SIZE];
+  GameHistory *history; // Where the moves played are recorded, NULL for none
   int moves_completed;
-  int depth; // Start from desired depth and decrement until 0
+  int halfmove_clock; // Moves since the last capture, pawn move or null move, for the fifty-move rule
+  int depth;     // Start from desired depth and decrement until 0
+  uint64_t hash; // Zobrist hash, updated by every move played
+  CheckInfo checkInfo;
 } ChessBoard;
 
+/*
+ * What a move played in place destroyed, so that it can be taken back. Much smaller than the
+ * chess board itself, which is too big to copy at every node of a search
+ */
+typedef struct
+{
+  Move move;
+  Piece moving;       // Piece on the origin square, a pawn for promotions
+  Piece captured;     // Captured piece, EMPTY_PIECE if none
+  Square capturedOn;  // Square of the captured piece, which is not the move's to square en passant
+  Square enPassant;
+  BitBoard castling;
+  uint64_t hash;
+  int halfmoveClock;
+  CheckInfo checkInfo; // Still valid once the move is taken back
+} Undo;
 
 
 /*
@@ -45,11 +118,48 @@ typedef struct
  */
 ChessBoard ChessBoardNew(char *fen, int depth); // Stack allocated
 
+/*
+ * Copies a board, giving the copy history as its own history with the moves played so far
+ */
+void ChessBoardCopy(ChessBoard *copy, GameHistory *history, ChessBoard *cb);
+
 /*
  * Given an old board and a new board, copy the old board and play the move on the new board
  */
 void ChessBoardPlayMove(ChessBoard *new, ChessBoard *old, Move move);
 
+/*
+ * Plays a move in place, filling undo with what is needed to take it back
+ */
+void ChessBoardMakeMove(ChessBoard *cb, Move move, Undo *undo);
+
+/*
+ * Takes back the last move played with ChessBoardMakeMove
+ */
+void ChessBoardUnmakeMove(ChessBoard *cb, Undo *undo);
+
+/*
+ * Passes the turn to the opponent in place, as null move pruning assumes. Recorded in the
+ * history as a move from a square to itself.
+ */
+void ChessBoardMakeNullMove(ChessBoard *cb, Undo *undo);
+
+/*
+ * Takes back a null move played with ChessBoardMakeNullMove
+ */
+void ChessBoardUnmakeNullMove(ChessBoard *cb, Undo *undo);
+
+/*
+ * Returns true if the move is the null move, which no legal move equals
+ */
+bool ChessBoardIsNullMove(Move m);
+
+/*
+ * Returns how many times the current position occurred before in the history, 0 without one. Only the
+ * moves since the last capture, pawn move or null move are looked at, as no earlier position can repeat.
+ */
+int ChessBoardRepetitions(ChessBoard *cb);
+
 /*
  * Prints a chess board to stdout
  */
@@ -61,17 +171,25 @@ void ChessBoardPrintBoard(ChessBoard cb);
 void ChessBoardPrintMove(Move m, long nodes);
 
 /*
- * Given a chess board, returns a set of squares representing their pieces that are giving check
+ * Given a chess board, returns a set of squares representing their pieces that are giving check.
+ * Cached in the board along with ChessBoardPinned.
  */
 BitBoard ChessBoardChecking(LookupTable l, ChessBoard *cb);
 
 /*
- * Given a chess board, returns a set of squares representing our pieces that are pinned
+ * Returns true if the side that just moved left its king attacked, i.e. if its last move was illegal
+ */
+bool ChessBoardLeftInCheck(LookupTable l, ChessBoard *cb);
+
+/*
+ * Given a chess board, returns a set of squares representing our pieces that are pinned.
+ * Cached in the board along with ChessBoardChecking.
  */
 BitBoard ChessBoardPinned(LookupTable l, ChessBoard *cb);
 
 /*
- * Given a chess board, returns a set of squares representing the squares that are attacked by their pieces
+ * Given a chess board, returns a set of squares representing the squares that are attacked by their pieces.
+ * Cached in the board.
  */
 BitBoard ChessBoardAttacked(LookupTable l, ChessBoard *cb);
 
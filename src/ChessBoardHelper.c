@@ -10,29 +10,53 @@
 #include <stdbool.h>
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 // NEW CODE
 
-// Assumes the input string is in the correct format (e.g., "e2e4")
+// Assumes the input string is in the correct format (e.g., "e2e4", or "e7e8n" to underpromote)
 Move parseMove(const char *moveStr, ChessBoard *cb) {
-    Piece *board = cb->squares;
-    Move move;
-
     // Convert from algebraic notation to 0-63 square index
-    move.from = (8 - (moveStr[1] - '0')) * 8 + (moveStr[0] - 'a');
-    move.to = (8 - (moveStr[3] - '0')) * 8 + (moveStr[2] - 'a');
-    move.moved = board[move.from]; // Get the piece from the board at the "from" square
+    Square from = (8 - (moveStr[1] - '0')) * 8 + (moveStr[0] - 'a');
+    Square to = (8 - (moveStr[3] - '0')) * 8 + (moveStr[2] - 'a');
+    Type moving = GET_TYPE(cb->squares[from]); // Get the piece from the board at the "from" square
 
-    return move;
+    // The board tells the kind of move, a pawn reaching the last rank becomes a queen unless told otherwise
+    if (moving == King && (from - to == 2 || to - from == 2)) {
+        return MOVE_NEW(from, to, MOVE_CASTLE);
+    }
+    if (moving == Pawn && to == cb->enPassant) {
+        return MOVE_NEW(from, to, MOVE_EN_PASSANT);
+    }
+    if (moving == Pawn && (to / 8 == 0 || to / 8 == 7)) {
+        const char *promotions = "nbrq";
+        const char *promoted = (moveStr[4] != '\0') ? strchr(promotions, moveStr[4]) : NULL;
+        Type t = (promoted != NULL) ? (Type)(Knight + (promoted - promotions)) : Queen;
+        return MOVE_NEW(from, to, MOVE_PROMOTION_TO(t));
+    }
+    return MOVE_NEW(from, to, MOVE_NORMAL);
 }
 
-// Converts a Move object to a move string (e.g., "e2e4")
+// Converts a Move object to a move string (e.g., "e2e4", "e7e8q" for promotions)
 char *moveToString(Move move) {
-    static char moveStr[5];
+    static char moveStr[6];
+    Square from = MOVE_FROM(move);
+    Square to = MOVE_TO(move);
     // Convert from 0-63 square index to algebraic notation
-    moveStr[0] = 'a' + (move.from % 8); // File of "from" square
-    moveStr[1] = '8' - (move.from / 8); // Rank of "from" square
-    moveStr[2] = 'a' + (move.to % 8);   // File of "to" square
-    moveStr[3] = '8' - (move.to / 8);   // Rank of "to" square
-    moveStr[4] = '\0';                  // Null terminator for the string
+    moveStr[0] = 'a' + (from % 8); // File of "from" square
+    moveStr[1] = '8' - (from / 8); // Rank of "from" square
+    moveStr[2] = 'a' + (to % 8);   // File of "to" square
+    moveStr[3] = '8' - (to / 8);   // Rank of "to" square
+    moveStr[4] = MOVE_IS_PROMOTION(move) ? "nbrq"[MOVE_PROMOTED(move) - Knight] : '\0';
+    moveStr[5] = '\0';            // Null terminator for the string
     return moveStr;
-}
\ No newline at end of file
+}
+
+int parseOption(int argc, char **argv, const char *name, int fallback) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return atoi(argv[i + 1]);
+        }
+    }
+    return fallback;
+}
@@ -5,4 +5,7 @@ Move parseMove(const char *moveStr, ChessBoard *cb);
 
 char *moveToString(Move move);
 
+// Returns the value following the option name, e.g. "--threads 8", or fallback if it is absent
+int parseOption(int argc, char **argv, const char *name, int fallback);
+
 #endif
\ No newline at end of file
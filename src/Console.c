@@ -0,0 +1,108 @@
+#define _XOPEN_SOURCE 700
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "Zobrist.h"
+#include "Dictionary.h"
+#include "Branch.h"
+#include "Minimax.h"
+#include "ChessBoardHelper.h"
+#include "Console.h"
+
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+volatile sig_atomic_t interrupted = 0;
+
+// Lines read by think while searching which were not meant for it, oldest first
+static char pending[PENDING_LINES][LINE_SIZE];
+static int pendingSize = 0;
+
+static void interruptHandler(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+void catchInterrupts(void) {
+    // No SA_RESTART, so that a read waiting for the player fails and the program gets to check interrupted
+    struct sigaction sa;
+    sa.sa_handler = interruptHandler;
+    sa.sa_flags = 0;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);  // Handle Ctrl+C
+    sigaction(SIGTERM, &sa, NULL); // Handle termination
+    sigaction(SIGQUIT, &sa, NULL); // Handle quit
+    sigaction(SIGTSTP, &sa, NULL); // Handle Ctrl+Z
+}
+
+Move think(Search *search, FILE *out, bool watchStdin) {
+    SearchLine lines[MAX_MULTI_PV];
+    int linesSize = search->limits.multiPv;
+    int reported = -1;
+    while (!SearchPoll(search, lines)) {
+        if (interrupted) {
+            SearchStop(search);
+        }
+        if (out != NULL && lines[0].depth > reported) {
+            reportLines(out, lines, linesSize);
+            reported = lines[0].depth;
+        }
+        struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+        if (!watchStdin || pendingSize == PENDING_LINES) {
+            nanosleep(&(struct timespec){.tv_nsec = POLL_MS * 1000000L}, NULL);
+        } else if (poll(&input, 1, POLL_MS) > 0) {
+            char *command = pending[pendingSize];
+            if (fgets(command, LINE_SIZE, stdin) == NULL) {
+                watchStdin = false; // stdin is closed, only the time control ends the search
+            } else if (strncmp(command, "stop", 4) == 0) {
+                SearchStop(search);
+            } else {
+                pendingSize++;
+            }
+        }
+    }
+    Move move = SearchWait(search, lines);
+    if (out != NULL && lines[0].depth > reported) {
+        reportLines(out, lines, linesSize);
+    }
+    return move;
+}
+
+void reportLines(FILE *out, SearchLine *lines, int linesSize) {
+    for (int i = 0; i < linesSize && lines[i].length > 0; i++) {
+        reportLine(out, &lines[i], linesSize > 1 ? i + 1 : 0);
+    }
+}
+
+void reportLine(FILE *out, SearchLine *line, int multiPv) {
+    fprintf(out, "depth %d ", line->depth);
+    if (multiPv > 0) {
+        fprintf(out, "multipv %d ", multiPv);
+    }
+    fprintf(out, "score ");
+    if (line->score >= MATE_BOUND) {
+        fprintf(out, "mate %d", (MATE_SCORE - line->score + 1) / 2);
+    } else if (line->score <= -MATE_BOUND) {
+        fprintf(out, "mate -%d", (MATE_SCORE + line->score) / 2);
+    } else {
+        fprintf(out, "cp %d", line->score);
+    }
+    fprintf(out, " nodes %ld pv", line->nodes);
+    for (int i = 0; i < line->length; i++) {
+        fprintf(out, " %s", moveToString(line->moves[i]));
+    }
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+bool readLine(char *line, int size) {
+    if (pendingSize == 0) {
+        return fgets(line, size, stdin) != NULL;
+    }
+    snprintf(line, size, "%s", pending[0]);
+    pendingSize--;
+    memmove(pending[0], pending[1], pendingSize * sizeof(pending[0]));
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define POLL_MS 20       // How often a running search is polled
+#define LINE_SIZE 256    // Longest line of stdin kept by think
+#define PENDING_LINES 16 // Lines of stdin think can keep
+
+// Set once SIGINT or SIGTERM arrives. The program then stops its searches before freeing what they use.
+extern volatile sig_atomic_t interrupted;
+
+// Catches the signals ending the program with a handler which only sets interrupted
+void catchInterrupts(void);
+
+/*
+ * Waits for the search to finish, printing the lines of every newly completed depth to out if not NULL.
+ * An interrupt ends it early. With watchStdin a "stop" line on stdin does too, and any other line is
+ * kept for readLine. stdin must then be unbuffered, so that poll sees every line stdio has not handed out yet.
+ */
+Move think(Search *search, FILE *out, bool watchStdin);
+
+// One line of output per line searched, numbered from 1 by multipv when there are several
+void reportLines(FILE *out, SearchLine *lines, int linesSize);
+
+void reportLine(FILE *out, SearchLine *line, int multiPv);
+
+// Reads the next line of stdin, the ones kept by think first. Returns false at the end of stdin.
+bool readLine(char *line, int size);
+
+#endif
@@ -10,128 +10,156 @@
 #include "Zobrist.h"
 #include "Dictionary.h"
 
+// Layout of Entry.data: score 0-31, depth 32-39, age 40-45, bound 46-47, move 48-63.
+// Every stored entry has a non-zero bound, so a zeroed entry reads as empty.
+#define AGE_MASK 0x3F
+#define DATA_SCORE(d) ((int32_t)(uint32_t)(d))
+#define DATA_DEPTH(d) ((uint8_t)((d) >> 32))
+#define DATA_AGE(d) ((uint8_t)(((d) >> 40) & AGE_MASK))
+#define DATA_BOUND(d) ((uint8_t)(((d) >> 46) & 0x3))
+#define DATA_MOVE(d) ((uint16_t)((d) >> 48))
+#define PACK_DATA(score, depth, age, bound, move) ((uint64_t)(uint32_t)(score) | ((uint64_t)(depth) << 32) | \
+                                                   ((uint64_t)((age) & AGE_MASK) << 40) | ((uint64_t)(bound) << 46) | ((uint64_t)(move) << 48))
+
+#define DICT_MAGIC 0x54434448 // "HDCT" read as a little-endian word, first in every saved dictionary
+#define DICT_VERSION 2        // Bumped whenever the layout of a saved entry changes
+#define AGE_WEIGHT 8 // Depth an entry loses per search it has been left untouched, when picking a victim
+
+// Snapshot returned by lookup, one per thread so helper threads never read a half written entry
+static _Thread_local nlist found;
+
+/* init_dictionary: allocate a table of the largest power of two of buckets that fits in megabytes */
+void init_dictionary(Dictionary *dict, int megabytes)
+{
+    uint64_t bytes = (uint64_t)(megabytes > 0 ? megabytes : 1) << 20;
+    dict->size = 1;
+    while (dict->size * 2 * sizeof(Bucket) <= bytes) {
+        dict->size *= 2;
+    }
 
-
-
-/* init_dictionary: initialize the dictionary */
-void init_dictionary(Dictionary *dict)
-{   
-    if (malloc(sizeof(*dict)) == NULL) {
-        printf("Failed to allocate memory for dictionary\n");
+    dict->buckets = aligned_alloc(sizeof(Bucket), dict->size * sizeof(Bucket));
+    if (dict->buckets == NULL) {
+        fprintf(stderr, "Failed to allocate memory for dictionary\n");
         exit(1);
     }
+    clear_dictionary(dict);
 
-    printf("Allocated memory for dictionary\n");
-    for (int i = 0; i < HASHSIZE; i++) {
-        dict->hashtab[i] = NULL;
-    }
-    printf("Initialized hashtab\n");
+    dict->zobrist = init_zobrist();
     if (DICT_FILENAME != NULL) {
-        if (load_dictionary(dict)) {
-            printf("Failed to load dictionary from file %s\n", DICT_FILENAME);
-        }
+        load_dictionary(dict);
     }
-    printf("Loaded dictionary from file\n");
-    dict->zobrist = init_zobrist();
+    age_dictionary(dict); // Entries loaded from file count as an earlier search
 }
 
-/* hash: form hash value for uint64_t key */
-unsigned hash(uint64_t key){
-    return key % HASHSIZE;
+/* hash: form the bucket index for uint64_t key */
+unsigned hash(Dictionary *dict, uint64_t key){
+    return key & (dict->size - 1);
 }
 
-/* Helper function to create a new nlist node */
-static nlist *create_node(uint64_t key, int32_t score, uint8_t depth) {
-    nlist *node = (nlist *)malloc(sizeof(nlist));
-    if (node == NULL) {
-        return NULL;
+/* lookup: look for key in its bucket */
+nlist *lookup(Dictionary *dict, uint64_t key)
+{
+    Bucket *bucket = &dict->buckets[hash(dict, key)];
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        Entry e = bucket->entries[i];
+        if ((e.check ^ e.data) == key && e.data != 0) {
+            found.key = key;
+            found.score = DATA_SCORE(e.data);
+            found.depth = DATA_DEPTH(e.data);
+            found.age = DATA_AGE(e.data);
+            found.bound = DATA_BOUND(e.data);
+            found.move = DATA_MOVE(e.data);
+            return &found;
+        }
     }
-    node->key = key;
-    node->score = score;
-    node->depth = depth;
-    node->left = node->right = NULL;
-    return node;
+    return NULL;
 }
 
-/* Helper function to insert a node into a binary search tree */
-static nlist *insert_node(nlist *root, uint64_t key, int32_t score, uint8_t depth) {
-    // If tree is empty or we've reached a leaf node, create a new node
-    if (root == NULL) {
-        return create_node(key, score, depth);
-    }
-    
-    // If key already exists, update score and depth
-    if (key == root->key) {
-        root->score = score;
-        root->depth = depth;
-        return root;
-    }
-    
-    // Recursively insert into the appropriate subtree
-    if (key < root->key) {
-        root->left = insert_node(root->left, key, score, depth);
-    } else {
-        root->right = insert_node(root->right, key, score, depth);
-    }
-    
-    return root;
+/* put: put the exact (key, score, depth) in its bucket */
+nlist *put(Dictionary *dict, uint64_t key, int32_t score, uint8_t depth)
+{
+    return put_bound(dict, key, score, depth, BOUND_EXACT, MOVE_NULL);
 }
 
-/* Helper function for searching in a binary search tree */
-static nlist *search_node(nlist *root, uint64_t key) {
-    // Base case: tree is empty or key is found
-    if (root == NULL || root->key == key) {
-        return root;
-    }
-    
-    // Search in the appropriate subtree
-    if (key < root->key) {
-        return search_node(root->left, key);
-    } else {
-        return search_node(root->right, key);
+/*
+ * put_bound: put (key, score, depth, bound, move) in its bucket. An entry for the same key is
+ * only replaced by a search at least as deep, unless it was left over from an earlier search,
+ * and keeps its move if the new search found none. Otherwise the entry with the lowest depth,
+ * corrected for how many searches ago it was written, is replaced.
+ */
+nlist *put_bound(Dictionary *dict, uint64_t key, int32_t score, uint8_t depth, uint8_t bound, Move move)
+{
+    Bucket *bucket = &dict->buckets[hash(dict, key)];
+    Entry *victim = NULL;
+    int victimValue = INT32_MAX;
+    uint16_t packedMove = ChessBoardIsNullMove(move) ? MOVE_NULL : move;
+    uint8_t age = dict->age & AGE_MASK;
+
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        Entry *e = &bucket->entries[i];
+        uint64_t data = e->data;
+        if ((e->check ^ data) == key && data != 0) {
+            if (depth < DATA_DEPTH(data) && DATA_AGE(data) == age) {
+                return lookup(dict, key);
+            }
+            if (packedMove == 0) {
+                packedMove = DATA_MOVE(data);
+            }
+            victim = e;
+            break;
+        }
+        int value = (data == 0) ? INT32_MIN : DATA_DEPTH(data) - AGE_WEIGHT * ((age - DATA_AGE(data)) & AGE_MASK);
+        if (value < victimValue) {
+            victimValue = value;
+            victim = e;
+        }
     }
-}
 
-/* lookup: look for key in hashtab using BST */
-nlist *lookup(Dictionary *dict, uint64_t key)
-{
-    unsigned hashval = hash(key);
-    return search_node(dict->hashtab[hashval], key);
+    uint64_t data = PACK_DATA(score, depth, age, bound, packedMove);
+    victim->data = data;
+    victim->check = key ^ data;
+    return lookup(dict, key);
 }
 
-/* put: put (key, score, depth) in hashtab using BST */
-nlist *put(Dictionary *dict, uint64_t key, int32_t score, uint8_t depth)
+/* install_board: put (board, score, depth) in the table */
+nlist *install_board(Dictionary *dict, ChessBoard *board, int32_t score, uint8_t depth)
 {
-    unsigned hashval = hash(key);
-    dict->hashtab[hashval] = insert_node(dict->hashtab[hashval], key, score, depth);
-    return search_node(dict->hashtab[hashval], key);
+    uint64_t key = board->hash;
+    return put(dict, key, score, depth);
 }
 
-/* install_board: put (board, score, depth) in hashtab */
-nlist *install_board(Dictionary *dict, ChessBoard *board, int32_t score, uint8_t depth)
+/* install_bound: put (board, score, depth, bound, move) in the table */
+nlist *install_bound(Dictionary *dict, ChessBoard *board, int32_t score, uint8_t depth, uint8_t bound, Move move)
 {
-    uint64_t key = get_zobrist_hash(board, dict->zobrist);
-    return put(dict, key, score, depth);
+    uint64_t key = board->hash;
+    return put_bound(dict, key, score, depth, bound, move);
 }
 
-/* lookup_board: look for board in hashtab */
+/* lookup_board: look for board in the table */
 nlist *lookup_board(Dictionary *dict, ChessBoard *board)
 {
-    uint64_t key = get_zobrist_hash(board, dict->zobrist);
+    uint64_t key = board->hash;
     return lookup(dict, key);
 }
 
-/* Helper function to traverse BST in-order and save nodes */
-static void save_tree_nodes(nlist *root, FILE *file) {
-    if (root != NULL) {
-        save_tree_nodes(root->left, file);
-        
-        fwrite(&root->key, sizeof(root->key), 1, file);
-        fwrite(&root->score, sizeof(root->score), 1, file);
-        fwrite(&root->depth, sizeof(root->depth), 1, file);
-        
-        save_tree_nodes(root->right, file);
-    }
+/* prefetch_board: start loading the bucket of board into cache before it is probed */
+void prefetch_board(Dictionary *dict, ChessBoard *board)
+{
+    uint64_t key = board->hash;
+    __builtin_prefetch(&dict->buckets[hash(dict, key)]);
+}
+
+/* age_dictionary: mark the start of a new search so entries from older searches are replaced first */
+void age_dictionary(Dictionary *dict)
+{
+    dict->age++;
+}
+
+/* clear_dictionary: empty every bucket */
+void clear_dictionary(Dictionary *dict)
+{
+    memset(dict->buckets, 0, dict->size * sizeof(Bucket));
+    dict->age = 0;
 }
 
 /* save_dictionary: save the current dictionary to a file */
@@ -140,10 +168,29 @@ int save_dictionary(Dictionary *dict)
     FILE *file = fopen(DICT_FILENAME, "wb");
     if (file == NULL)
         return -1;
-    
-    for (int i = 0; i < HASHSIZE; i++) {
-        if (dict->hashtab[i] != NULL) {
-            save_tree_nodes(dict->hashtab[i], file);
+
+    uint32_t magic = DICT_MAGIC;
+    uint32_t version = DICT_VERSION;
+    fwrite(&magic, sizeof(magic), 1, file);
+    fwrite(&version, sizeof(version), 1, file);
+
+    for (uint64_t i = 0; i < dict->size; i++) {
+        for (int j = 0; j < BUCKET_SIZE; j++) {
+            Entry e = dict->buckets[i].entries[j];
+            if (e.data == 0) {
+                continue;
+            }
+            uint64_t key = e.check ^ e.data;
+            int32_t score = DATA_SCORE(e.data);
+            uint8_t depth = DATA_DEPTH(e.data);
+            uint8_t bound = DATA_BOUND(e.data);
+            uint16_t move = DATA_MOVE(e.data);
+
+            fwrite(&key, sizeof(key), 1, file);
+            fwrite(&score, sizeof(score), 1, file);
+            fwrite(&depth, sizeof(depth), 1, file);
+            fwrite(&bound, sizeof(bound), 1, file);
+            fwrite(&move, sizeof(move), 1, file);
         }
     }
 
@@ -151,48 +198,52 @@ int save_dictionary(Dictionary *dict)
     return 0;
 }
 
-/* load_dictionary: load the dictionary from a file */
+/* load_dictionary: load the dictionary from a file, refusing one saved without the current magic and version */
 int load_dictionary(Dictionary *dict)
 {
     FILE *file = fopen(DICT_FILENAME, "rb");
     if (file == NULL)
         return -1;
 
+    uint32_t magic;
+    uint32_t version;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 || fread(&version, sizeof(version), 1, file) != 1 ||
+        magic != DICT_MAGIC || version != DICT_VERSION) {
+        fprintf(stderr, "Ignoring %s: not a dictionary of version %d\n", DICT_FILENAME, DICT_VERSION);
+        fclose(file);
+        return -1;
+    }
+
     uint64_t key;
     int32_t score;
     uint8_t depth;
+    uint8_t bound;
+    uint16_t move;
 
     while (fread(&key, sizeof(key), 1, file) == 1) {
         if (fread(&score, sizeof(score), 1, file) != 1 ||
-            fread(&depth, sizeof(depth), 1, file) != 1) {
+            fread(&depth, sizeof(depth), 1, file) != 1 ||
+            fread(&bound, sizeof(bound), 1, file) != 1 ||
+            fread(&move, sizeof(move), 1, file) != 1) {
             fclose(file);
             return -1;
         }
-        put(dict, key, score, depth);
+        if (bound < BOUND_UPPER || bound > BOUND_EXACT) {
+            continue; // Damaged entry, a zero bound would also read as an empty slot
+        }
+        put_bound(dict, key, score, depth, bound, move);
     }
 
     fclose(file);
     return 0;
 }
 
-/* Helper function to free a BST */
-static void free_tree(nlist *root) {
-    if (root != NULL) {
-        free_tree(root->left);
-        free_tree(root->right);
-        free(root);
-    }
-}
-
 /* free_dictionary: free the dictionary */
 void free_dictionary(Dictionary *dict)
 {
-    for (int i = 0; i < HASHSIZE; i++) {
-        if (dict->hashtab[i] != NULL) {
-            free_tree(dict->hashtab[i]);
-            dict->hashtab[i] = NULL;
-        }
-    }
+    free(dict->buckets);
+    dict->buckets = NULL;
+    dict->size = 0;
 }
 
 /* exit_dictionary: save the current dictionary to a file, then free the dictionary */
@@ -1,32 +1,63 @@
 #ifndef DICTIONARY_H
 #define DICTIONARY_H
 
-#define HASHSIZE 100001
+#define DEFAULT_HASH_MB 64
+#define BUCKET_SIZE 4 // Entries per 64-byte bucket
+
+// What a stored score says about the true score of the position
+#define BOUND_UPPER 1 // The search failed low, the true score is at most the stored score
+#define BOUND_LOWER 2 // The search failed high, the true score is at least the stored score
+#define BOUND_EXACT 3
 
 static const char *DICT_FILENAME = "src/data/heuristicDict.dat";
 
+/*
+ * Snapshot of a dictionary entry as returned by lookup. The snapshot is owned by the
+ * calling thread and stays valid until that thread's next lookup.
+ */
 typedef struct nlist {
-    struct nlist *left;   // Left child in BST
-    struct nlist *right;  // Right child in BST
     uint64_t key;
     int32_t score;
     uint8_t depth;
+    uint8_t age;
+    uint8_t bound;
+    Move move;      // Best move found, MOVE_NULL if there is none
 } nlist;
 
+/*
+ * An entry as stored in the table. The score, depth, age, bound and move are packed into data, and
+ * check holds key ^ data so an entry torn by two threads writing at once never matches.
+ */
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} Entry;
+
+typedef struct {
+    Entry entries[BUCKET_SIZE];
+} __attribute__((aligned(64))) Bucket;
+
 typedef struct {
     Zobrist_Table *zobrist;
-    nlist *hashtab[HASHSIZE];
+    Bucket *buckets;
+    uint64_t size;  // Number of buckets, always a power of two
+    uint8_t age;    // Incremented at the start of every search
 } Dictionary;
 
-void init_dictionary(Dictionary *dict);
-unsigned hash(uint64_t key);
+void init_dictionary(Dictionary *dict, int megabytes);
+unsigned hash(Dictionary *dict, uint64_t key);
 nlist *lookup(Dictionary *dict, uint64_t key);
 nlist *put(Dictionary *dict, uint64_t key, int32_t score, uint8_t depth);
+nlist *put_bound(Dictionary *dict, uint64_t key, int32_t score, uint8_t depth, uint8_t bound, Move move);
 nlist *install_board(Dictionary *dict, ChessBoard *board, int32_t score, uint8_t depth);
+nlist *install_bound(Dictionary *dict, ChessBoard *board, int32_t score, uint8_t depth, uint8_t bound, Move move);
 nlist *lookup_board(Dictionary *dict, ChessBoard *board);
+void prefetch_board(Dictionary *dict, ChessBoard *board);
+void age_dictionary(Dictionary *dict);
+void clear_dictionary(Dictionary *dict);
 int save_dictionary(Dictionary *dict);
 int load_dictionary(Dictionary *dict);
 void free_dictionary(Dictionary *dict);
 void exit_dictionary(Dictionary *dict);
 
-#endif /* DICTIONARY_H */
\ No newline at end of file
+#endif /* DICTIONARY_H */
@@ -12,7 +12,6 @@
 #include <time.h>
 #include <stdio.h>
 
-#define PIECE_FACTOR 100
 #define ATTACK_FACTOR 3
 #define CASTLING_FACTOR 25
 
@@ -22,8 +21,8 @@
 #define WHITE_PIECE(t) (board->pieces[GET_PIECE(t, White)])                                     // Bitboard representing our pieces of type t
 #define BLACK_PIECE(t) (board->pieces[GET_PIECE(t, Black)])                                  // Bitboard representing their pieces of type t
 
-#define WHITE_PIECES (WHITE_PIECE(Pawn) | WHITE_PIECE(Knight) | WHITE_PIECE(Bishop) | WHITE_PIECE(Rook) | WHITE_PIECE(Queen) | WHITE_PIECE(King)) // Bitboard of all our pieces
-#define BLACK_PIECES (BLACK_PIECE(Pawn) | BLACK_PIECE(Knight) | BLACK_PIECE(Bishop) | BLACK_PIECE(Rook) | BLACK_PIECE(Queen) | BLACK_PIECE(King)) // Bitboard of all their pieces
+#define WHITE_PIECES (board->occupancy[White]) // Bitboard of all our pieces
+#define BLACK_PIECES (board->occupancy[Black]) // Bitboard of all their pieces
 
 
 
@@ -33,13 +32,12 @@
     * Parameters:
     * - l: LookupTable containing precomputed attack patterns
     * - board: Pointer to the current chess board
-    * - dict: Dictionary for storing and retrieving board positions
     * 
     * Returns:
     * - An integer score representing the evaluation of the position in favor of the black player
     
 */
-int heuristic(LookupTable l, ChessBoard *board, Dictionary *dict) {
+int heuristic(LookupTable l, ChessBoard *board) {
     int score = 0;
     
     
@@ -50,14 +48,7 @@ int heuristic(LookupTable l, ChessBoard *board, Dictionary *dict) {
     if (BLACK_PIECE(King) == 0) {
         return INT_MIN;
     }
-    
 
-    if (dict->zobrist != NULL) {
-        int dictScore = betterDictScore(board, dict);
-        if (dictScore) {
-            return dictScore;
-        }
-    }
     
     // Find threats
 
@@ -103,23 +94,11 @@ int heuristic(LookupTable l, ChessBoard *board, Dictionary *dict) {
     score -= BitBoardCountBits(board->castling & BACK_RANK(White))*CASTLING_FACTOR;
     score += BitBoardCountBits(board->castling & BACK_RANK(Black))*CASTLING_FACTOR;
     
-    
-    if (dict->zobrist != NULL) {
-        install_board(dict, board, score, 0);
-    }
 
     return score;
 }
 
 
-int betterDictScore(ChessBoard *board, Dictionary *dict){
-    nlist *np = lookup_board(dict, board);
-    if (np != NULL && np->depth >= board->depth) {
-        return np->score;
-    }
-    return 0;
-}
-
 int pieceScore(int pieceType) {
     switch (pieceType) {
         case Pawn:
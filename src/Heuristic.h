@@ -1,8 +1,11 @@
 #ifndef HEURISTIC_H
 #define HEURISTIC_H
 
-int heuristic(LookupTable l, ChessBoard *board, Dictionary *dict);
-int betterDictScore(ChessBoard *board, Dictionary *dict);
+#include <stdbool.h>
+
+#define PIECE_FACTOR 100 // Centipawns per point of pieceScore
+
+int heuristic(LookupTable l, ChessBoard *board);
 int pieceScore(int pieceType);
 
 #endif
\ No newline at end of file
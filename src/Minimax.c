@@ -7,274 +7,1008 @@
 #include "Heuristic.h"
 #include "Minimax.h"
 #include "ChessBoardHelper.h"
+#include "See.h"
 
 
 #include <stdio.h>
 #include <limits.h>
+#include <math.h>
 #include <stdbool.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 int stage = 0;
 
-// Updated function signature to return scores
-int* sortMoves(Move *moves, int size, ChessBoard *board, LookupTable l, Dictionary *dict);
-void mergeSort(int *scores, Move *moves, int l, int r);
-void merge(int *scores, Move *moves, int l, int m, int r);
+// Everything one thread needs to run its own iterative deepening loop
+typedef struct SearchWorker {
+    SearchThread thread;
+    Search *search;     // Search this worker belongs to, where it publishes its iterations
+    struct SearchWorker *workers; // All the workers of the search, the main thread's first
+    LookupTable l;
+    ChessBoard board;   // Private copy of the root position
+    GameHistory history; // Private copy of the moves leading to it, where the board records the moves searched
+    Dictionary *dict;
+    int minDepth;
+    int depth_speed;
+    bool verbose;
+    bool stats;
+    int threads;        // Size of the workers array this worker belongs to
+    int multiPv;        // Lines searched by this worker, only the main thread searches more than one
+    SearchLine lines[MAX_MULTI_PV]; // Lines of the deepest fully searched iteration, best first, depth -1 if none
+} SearchWorker;
+
+#define DELTA_MARGIN 200 // Centipawns a capture may gain on top of the captured piece, e.g. through position
+
+SearchConfig searchConfig = {
+    .nullMove = true,
+    .nullMoveMinDepth = 3,
+    .nullMoveReduction = 2,
+    .nullMoveDepthDivisor = 6,
+    .lateMoveReductions = true,
+    .lmrMinDepth = 3,
+    .lmrMinMoves = 3,
+    .lmrBase = 0.75,
+    .lmrDivisor = 2.25,
+    .reverseFutility = true,
+    .reverseFutilityDepth = 3,
+    .reverseFutilityMargin = 150,
+    .futility = true,
+    .futilityDepth = 3,
+    .futilityMargin = 200,
+    .razoring = true,
+    .razoringDepth = 2,
+    .razoringMargin = 300,
+    .aspirationWindow = 100,
+};
+
+static bool searchAborted(SearchThread *thread);
+static int evaluate(LookupTable l, ChessBoard *board);
+static int scoreToDict(int score, int ply, Color turn);
+static int scoreFromDict(int score, int ply, Color turn);
+static bool nullMoveCutoff(LookupTable l, ChessBoard *board, Dictionary *dict, int beta, SearchThread *thread, int staticEval);
+static int lateMoveReduction(int depth, int moveNumber);
+static int searchReduced(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, SearchThread *thread, int reduction);
+static int quiescence(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, SearchThread *thread);
+static void updatePv(SearchThread *thread, int ply, Move move);
+static void searchRoot(SearchWorker *worker, Move *moves, int *moveScores, int movesSize, int depth, int alpha, int beta, SearchLine *line);
+static int aspirationSearch(SearchWorker *worker, Move *moves, int *moveScores, int movesSize, int depth, SearchLine *previous, SearchLine *line);
+static void publishLines(Search *search, SearchLine *lines, int linesSize);
+static SearchStats totalStats(SearchWorker *workers, int threads);
+static SearchStats iterationStats(SearchStats *total, SearchStats *previous, SearchStats *previousIteration, long ms, int depthSpeed);
+static void printStats(int depth, SearchStats *stats);
+
+// Only the owning thread writes its counters, so a relaxed load/store pair is enough
+static inline void count(atomic_long *counter, long n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
 
+// The clock is only read every TIME_CHECK_NODES nodes, reaching the hard limit stops every thread
+static bool searchAborted(SearchThread *thread) {
+    if (thread->aborted) {
+        return true;
+    }
+    if (atomic_load_explicit(thread->stop, memory_order_relaxed)) {
+        thread->aborted = true;
+        return true;
+    }
+    if (thread->mustFinish || atomic_load_explicit(&thread->nodes, memory_order_relaxed) % TIME_CHECK_NODES != 0) {
+        return false;
+    }
+    if (TimeManagerHardLimit(thread->time)) {
+        atomic_store(thread->stop, true);
+        thread->aborted = true;
+        return true;
+    }
+    return false;
+}
 
-int minimax(LookupTable l, ChessBoard *oldBoard, Dictionary *dict, int alpha, int beta, bool maximizingPlayer, clock_t startTime, int timeLimit, bool mustFinish) {
+// The heuristic from the side to move's point of view, a missing king counts as being mated
+static int evaluate(LookupTable l, ChessBoard *board) {
+    int score = heuristic(l, board);
+    if (score == INT_MAX) {
+        score = MATE_SCORE;
+    } else if (score == INT_MIN) {
+        score = -MATE_SCORE;
+    }
+    return board->turn == Black ? score : -score;
+}
 
-    int final_score;
+/*
+ * The dictionary keeps scores from Black's point of view, like the heuristic, with mates counted
+ * from the stored position rather than from the root, so that they stay right in another search.
+ */
+static int scoreToDict(int score, int ply, Color turn) {
+    if (score >= MATE_BOUND) {
+        score += ply;
+    } else if (score <= -MATE_BOUND) {
+        score -= ply;
+    }
+    return turn == Black ? score : -score;
+}
 
-    if (((clock() - startTime) * 1000) >= timeLimit*CLOCKS_PER_SEC && !mustFinish) {
-        return maximizingPlayer ? INT_MIN : INT_MAX;
+static int scoreFromDict(int score, int ply, Color turn) {
+    score = turn == Black ? score : -score;
+    if (score >= MATE_BOUND) {
+        score -= ply;
+    } else if (score <= -MATE_BOUND) {
+        score += ply;
     }
+    return score;
+}
 
+/*
+ * Negamax with alpha-beta pruning and principal variation search: scores are from the side to
+ * move's point of view, the first move is searched with the full window and the others with a
+ * zero window, searched again in full only if they beat alpha. After an abort the returned score
+ * is meaningless, callers check thread->aborted.
+ */
+int negamax(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, SearchThread *thread) {
+    count(&thread->nodes, 1);
+
+    // The parent copies this node's line into its own, so it must be empty on every early return
+    int ply = board->moves_completed - thread->rootPly;
+    thread->pvLength[ply] = 0;
+    if (searchAborted(thread)) {
+        return 0;
+    }
+    if (ply >= MAX_PLY - 1 || board->moves_completed >= MOVELIST_SIZE - 1) {
+        return evaluate(l, board);
+    }
+
+    // A position already seen on the way here, or from the game, can be repeated forever: scored as a draw before the dictionary is probed
+    if (ply > 0 && ChessBoardRepetitions(board) > 0) {
+        return 0;
+    }
+    // The fifty-move rule draws unless the move reaching it mated, which only a position in check without legal moves can be
+    if (ply > 0 && board->halfmove_clock >= FIFTY_MOVE_PLIES) {
+        MoveList legal;
+        bool mated = ChessBoardChecking(l, board) != EMPTY_BOARD && BranchLegalMoves(l, board, &legal) == 0;
+        return mated ? -MATE_SCORE + ply : 0;
+    }
+    bool pvNode = beta - alpha > 1;
+    int depth = board->depth;
+
+    // Use what an earlier search stored: a score settling the node outside the principal variation, and its best move.
+    // Only scores searched at least one ply deep settle it, so no stored score ever stands in for the quiescence search.
+    Move ttMove = MOVE_NULL;
     if (dict->zobrist != NULL) {
-        int dictScore = betterDictScore(oldBoard, dict);
-        if (dictScore) {
-            return dictScore;
+        nlist *np = lookup_board(dict, board);
+        count(&thread->counters.ttProbes, 1);
+        if (np != NULL) {
+            count(&thread->counters.ttHits, 1);
+            ttMove = np->move;
+            int ttScore = scoreFromDict(np->score, ply, board->turn);
+            if (!pvNode && np->depth >= depth && np->depth > 0 &&
+                (np->bound == BOUND_EXACT || (np->bound == BOUND_LOWER && ttScore >= beta) || (np->bound == BOUND_UPPER && ttScore <= alpha))) {
+                count(&thread->counters.ttCutoffs, 1);
+                return ttScore;
+            }
         }
     }
-    
-    if (oldBoard->depth == 0) {
-        return heuristic(l, oldBoard, dict);
+
+    if (depth == 0) {
+        return quiescence(l, board, dict, alpha, beta, thread);
     }
 
-    Branch branches[BRANCHES_SIZE];
-    int branchesSize = BranchFill(l, oldBoard, branches);
-    Move moves[MOVES_SIZE];
-    int movesSize = BranchExtract(branches, branchesSize, moves);
+    // Forward pruning relies on the static evaluation, which means nothing in check
+    bool inCheck = ChessBoardChecking(l, board) != EMPTY_BOARD;
+    int staticEval = inCheck ? -SCORE_INFINITE : evaluate(l, board);
+    bool prunable = !inCheck && staticEval > -MATE_BOUND && staticEval < MATE_BOUND;
+
+    // Reverse futility pruning: far enough above beta that no move of the opponent is expected to bring it back
+    if (prunable && !pvNode && searchConfig.reverseFutility && depth <= searchConfig.reverseFutilityDepth &&
+        staticEval - searchConfig.reverseFutilityMargin * depth >= beta) {
+        return staticEval;
+    }
+
+    // Razoring: far enough below alpha that only captures are expected to help
+    if (prunable && !pvNode && searchConfig.razoring && depth <= searchConfig.razoringDepth &&
+        staticEval + searchConfig.razoringMargin * depth <= alpha) {
+        int score = quiescence(l, board, dict, alpha, beta, thread);
+        if (score <= alpha) {
+            return score;
+        }
+    }
+
+    if (prunable && !pvNode && nullMoveCutoff(l, board, dict, beta, thread, staticEval)) {
+        return beta;
+    }
+
+    // Futility pruning: quiet moves not giving check are skipped once the static evaluation is this far below alpha
+    bool futilityPruning = prunable && searchConfig.futility && depth <= searchConfig.futilityDepth;
+    int futilityMargin = searchConfig.futilityMargin * depth;
 
-    int* scores = NULL;
+    MovePicker picker;
+    MovePickerInit(&picker, l, board, &thread->order, ttMove, ply, inCheck);
+    int movesCount = MovePickerCount(&picker);
+    count(&thread->counters.branchFills, 1);
+    count(&thread->counters.branchFillMoves, movesCount);
 
-    // Sort moves and get the heuristic scores
-    if (oldBoard->depth == 1){
-        scores = sortMoves(moves, movesSize, oldBoard, l, dict);
+    if (movesCount == 0) {
+        return inCheck ? -MATE_SCORE + ply : 0;
     }
 
-    if (movesSize == 0) {
-        // Free allocated scores array if no moves
-        if (scores != NULL) {
-            free(scores);
+    int windowAlpha = alpha; // The window actually searched, which decides the bound of the result
+    Move tried[MOVES_SIZE];  // Moves searched so far, the quiet ones lose history on a later cutoff
+    int triedSize = 0;
+    int bestScore = -SCORE_INFINITE;
+    Move bestMove = MOVE_NULL;
+    Move move;
+
+    while (MovePickerNext(&picker, &move)) {
+        bool quiet = picker.stage == STAGE_KILLERS || picker.stage == STAGE_QUIETS;
+        bool lateQuiet = !inCheck && picker.stage == STAGE_QUIETS;
+        bool futile = futilityPruning && quiet && triedSize > 0 && staticEval + futilityMargin <= alpha;
+
+        Undo undo;
+        ChessBoardMakeMove(board, move, &undo);
+        if (!LEGAL_AFTER_MOVE(l, board)) {
+            ChessBoardUnmakeMove(board, &undo);
+            continue;
         }
-        if (ChessBoardChecking(l, oldBoard) != EMPTY_BOARD) {
-            if (oldBoard->turn == Black) {
-                return INT_MIN;
-            } else {
-                return INT_MAX;
-            }
+        if (dict->zobrist != NULL) {
+            prefetch_board(dict, board);
+        }
+
+        // Late quiet moves are searched shallower first, and again at full depth if they beat alpha
+        int reduction = lateQuiet ? lateMoveReduction(depth, triedSize + 1) : 0;
+        if ((futile || reduction > 0) && ChessBoardChecking(l, board) != EMPTY_BOARD) {
+            futile = false;
+            reduction = 0;
+        }
+        if (futile) {
+            ChessBoardUnmakeMove(board, &undo);
+            continue;
+        }
+        tried[triedSize++] = move;
+
+        int score;
+        if (triedSize == 1) {
+            score = -negamax(l, board, dict, -beta, -alpha, thread);
         } else {
+            score = -searchReduced(l, board, dict, -alpha - 1, -alpha, thread, reduction);
+            if (score > alpha && reduction > 0) {
+                score = -negamax(l, board, dict, -alpha - 1, -alpha, thread);
+            }
+            if (score > alpha && score < beta) {
+                score = -negamax(l, board, dict, -beta, -alpha, thread);
+            }
+        }
+        ChessBoardUnmakeMove(board, &undo);
+
+        if (thread->aborted) {
             return 0;
         }
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = move;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(thread, ply, move);
+                if (alpha >= beta) {
+                    count(&thread->counters.cutoffs, 1);
+                    count(&thread->counters.firstMoveCutoffs, triedSize == 1);
+                    MoveOrderUpdate(&thread->order, board, move, tried, triedSize - 1, depth, ply);
+                    break; // Alpha-beta pruning
+                }
+            }
+        }
+    }
+
+    // Only pseudo-legal generation gives moves which all turn out to leave the king attacked
+    if (triedSize == 0) {
+        return inCheck ? -MATE_SCORE + ply : 0;
+    }
+
+    // update the dictionary with the final score, which is only a bound if it fell outside the window
+    if (dict->zobrist != NULL) {
+        uint8_t bound = BOUND_EXACT;
+        if (bestScore <= windowAlpha) {
+            bound = BOUND_UPPER;
+            bestMove = picker.ttMove; // Every move failed low, so none of them is known to be best
+        } else if (bestScore >= beta) {
+            bound = BOUND_LOWER;
+        }
+        install_bound(dict, board, scoreToDict(bestScore, ply, board->turn), depth, bound, bestMove);
     }
-    if (maximizingPlayer) {
-        int maxEval = INT_MIN;
-        for (int i = 0; i < movesSize; i++) {
-            
-            Move move = moves[i];
-
-            ChessBoard newBoard;
-            ChessBoardPlayMove(&newBoard, oldBoard, move);
-
-            int eval;
-            // Rerun the heuristic if the depth is 0 and the move is a capture
-            if (newBoard.depth == 0 && (oldBoard->squares[move.to] != EMPTY_PIECE)) {
-                newBoard.depth = 1;
-                eval = minimax(l, &newBoard, dict, alpha, beta, false, startTime, timeLimit, mustFinish);
-            } else if (newBoard.depth == 0 && scores != NULL) {
-                // Reuse the score we already calculated during sorting, if we have sorted
-                eval = scores[i];
-            } else {
-                eval = minimax(l, &newBoard, dict, alpha, beta, false, startTime, timeLimit, mustFinish);
+
+    return bestScore;
+}
+
+// The line from ply is move followed by the line found from the next ply
+static void updatePv(SearchThread *thread, int ply, Move move) {
+    int length = thread->pvLength[ply + 1];
+    thread->pv[ply][0] = move;
+    memcpy(&thread->pv[ply][1], thread->pv[ply + 1], length * sizeof(Move));
+    thread->pvLength[ply] = length + 1;
+}
+
+/*
+ * Null move pruning: if passing the turn still fails high with a reduced search, a real move
+ * would too. Not tried in check, right after another null move, or when the side to move only
+ * has pawns left, where passing may be its only good option (zugzwang).
+ */
+static bool nullMoveCutoff(LookupTable l, ChessBoard *board, Dictionary *dict, int beta, SearchThread *thread, int staticEval) {
+    if (!searchConfig.nullMove || board->depth < searchConfig.nullMoveMinDepth) {
+        return false;
+    }
+    if (board->moves_completed > thread->rootPly && ChessBoardIsNullMove(board->history->moves[board->moves_completed - 1])) {
+        return false;
+    }
+    Color us = board->turn;
+    BitBoard pieces = board->occupancy[us] & ~(board->pieces[GET_PIECE(Pawn, us)] | board->pieces[GET_PIECE(King, us)]);
+    if (pieces == EMPTY_BOARD) {
+        return false;
+    }
+    // Only worth trying if the position already looks good enough without the move
+    if (staticEval < beta || beta >= MATE_BOUND) {
+        return false;
+    }
+
+    int reduction = searchConfig.nullMoveReduction + board->depth / searchConfig.nullMoveDepthDivisor;
+    Undo undo;
+    ChessBoardMakeNullMove(board, &undo);
+    int score = -searchReduced(l, board, dict, -beta, -beta + 1, thread, reduction);
+    ChessBoardUnmakeNullMove(board, &undo);
+    return score >= beta;
+}
+
+// Plies a quiet move is reduced by given the remaining depth and its position in the move ordering
+static int lateMoveReduction(int depth, int moveNumber) {
+    if (!searchConfig.lateMoveReductions || depth < searchConfig.lmrMinDepth || moveNumber <= searchConfig.lmrMinMoves) {
+        return 0;
+    }
+    int reduction = (int)(searchConfig.lmrBase + log(depth) * log(moveNumber) / searchConfig.lmrDivisor);
+    return (reduction < depth - 1) ? reduction : depth - 1; // Never straight into quiescence
+}
+
+// Searches the position after a move with reduction plies less than its depth
+static int searchReduced(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, SearchThread *thread, int reduction) {
+    int depth = board->depth;
+    board->depth = (depth > reduction) ? depth - reduction : 0;
+    int score = negamax(l, board, dict, alpha, beta, thread);
+    board->depth = depth;
+    return score;
+}
+
+/*
+ * Quiescence search: only captures and promotions are searched past the horizon, so the
+ * heuristic is only trusted in quiet positions. The side to move may stand pat on the
+ * heuristic, and captures which can't bring the score back above alpha even with
+ * DELTA_MARGIN to spare are skipped, as are captures losing material by static exchange
+ * evaluation. In check every evasion is searched instead.
+ */
+static int quiescence(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, SearchThread *thread) {
+    count(&thread->nodes, 1);
+    count(&thread->counters.qnodes, 1);
+
+    int ply = board->moves_completed - thread->rootPly;
+    thread->pvLength[ply] = 0;
+    if (searchAborted(thread)) {
+        return 0;
+    }
+    if (ply >= MAX_PLY - 1 || board->moves_completed >= MOVELIST_SIZE - 1) {
+        return evaluate(l, board);
+    }
+
+    bool inCheck = ChessBoardChecking(l, board) != EMPTY_BOARD;
+    int standPat = 0;
+    int bestScore = -SCORE_INFINITE;
+
+    if (!inCheck) {
+        standPat = evaluate(l, board);
+        if (standPat >= beta) {
+            return standPat;
+        }
+        alpha = (alpha > standPat) ? alpha : standPat;
+        bestScore = standPat;
+    }
+
+    Branch branches[BRANCHES_SIZE];
+    int branchesSize = inCheck ? BranchFillEvasions(l, board, branches) : BranchFillCaptures(l, board, branches);
+    MoveList list;
+    list.size = BranchExtract(branches, branchesSize, list.moves);
+    if (inCheck) {
+        count(&thread->counters.branchFills, 1);
+        count(&thread->counters.branchFillMoves, list.size);
+    }
+
+    for (int i = 0; i < list.size; i++) {
+        list.scores[i] = MoveOrderMvvLva(board, list.moves[i]);
+    }
+
+    for (int i = 0; i < list.size; i++) {
+        Move move = MoveOrderPick(&list, i);
+
+        if (!inCheck) {
+            Piece victim = board->squares[MOVE_TO(move)];
+            int gain = (victim == EMPTY_PIECE ? pieceScore(Pawn) : pieceScore(GET_TYPE(victim))) * PIECE_FACTOR + DELTA_MARGIN;
+            if (MOVE_IS_PROMOTION(move)) {
+                gain += pieceScore(MOVE_PROMOTED(move)) * PIECE_FACTOR;
+            }
+            if (standPat + gain <= alpha) {
+                continue; // Delta pruning
+            }
+            if (SeeEvaluate(l, board, move) < 0) {
+                continue;
             }
+        }
+
+        Undo undo;
+        ChessBoardMakeMove(board, move, &undo);
+        if (!LEGAL_AFTER_MOVE(l, board)) {
+            ChessBoardUnmakeMove(board, &undo);
+            continue;
+        }
+        int score = -quiescence(l, board, dict, -beta, -alpha, thread);
+        ChessBoardUnmakeMove(board, &undo);
 
-            maxEval = (eval > maxEval) ? eval : maxEval;
-            alpha = (alpha > eval) ? alpha : eval;
-            if (beta <= alpha){
-                break; // Alpha-beta pruning
+        if (thread->aborted) {
+            return 0;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
+                }
             }
         }
-        free(scores); // Free allocated memory
-        final_score = maxEval;
+    }
+
+    // In check every evasion is searched, so no score means there was none
+    if (inCheck && bestScore == -SCORE_INFINITE) {
+        return -MATE_SCORE + ply;
+    }
+    return bestScore;
+}
+
+static long totalNodes(SearchWorker *workers, int threads) {
+    long nodes = 0;
+    for (int i = 0; i < threads; i++) {
+        nodes += atomic_load_explicit(&workers[i].thread.nodes, memory_order_relaxed);
+    }
+    return nodes;
+}
+
+// Counters summed over the threads since the start of the search, the rates are left to iterationStats
+static SearchStats totalStats(SearchWorker *workers, int threads) {
+    SearchStats total = {0};
+    for (int i = 0; i < threads; i++) {
+        SearchThread *thread = &workers[i].thread;
+        total.nodes += atomic_load_explicit(&thread->nodes, memory_order_relaxed);
+        total.qnodes += atomic_load_explicit(&thread->counters.qnodes, memory_order_relaxed);
+        total.ttProbes += atomic_load_explicit(&thread->counters.ttProbes, memory_order_relaxed);
+        total.ttHits += atomic_load_explicit(&thread->counters.ttHits, memory_order_relaxed);
+        total.ttCutoffs += atomic_load_explicit(&thread->counters.ttCutoffs, memory_order_relaxed);
+        total.cutoffs += atomic_load_explicit(&thread->counters.cutoffs, memory_order_relaxed);
+        total.firstMoveCutoffs += atomic_load_explicit(&thread->counters.firstMoveCutoffs, memory_order_relaxed);
+        total.branchFills += atomic_load_explicit(&thread->counters.branchFills, memory_order_relaxed);
+        total.branchFillMoves += atomic_load_explicit(&thread->counters.branchFillMoves, memory_order_relaxed);
+        total.researches += atomic_load_explicit(&thread->counters.researches, memory_order_relaxed);
+    }
+    return total;
+}
+
+// Statistics of the iteration which took ms and ended with the counters at total, previous being their value when it started
+static SearchStats iterationStats(SearchStats *total, SearchStats *previous, SearchStats *previousIteration, long ms, int depthSpeed) {
+    SearchStats stats = {0};
+    stats.ms = ms;
+    stats.nodes = total->nodes - previous->nodes;
+    stats.qnodes = total->qnodes - previous->qnodes;
+    stats.ttProbes = total->ttProbes - previous->ttProbes;
+    stats.ttHits = total->ttHits - previous->ttHits;
+    stats.ttCutoffs = total->ttCutoffs - previous->ttCutoffs;
+    stats.cutoffs = total->cutoffs - previous->cutoffs;
+    stats.firstMoveCutoffs = total->firstMoveCutoffs - previous->firstMoveCutoffs;
+    stats.branchFills = total->branchFills - previous->branchFills;
+    stats.branchFillMoves = total->branchFillMoves - previous->branchFillMoves;
+    stats.researches = total->researches - previous->researches;
+
+    stats.nps = ms > 0 ? stats.nodes * 1000 / ms : stats.nodes;
+    // An iteration searches depthSpeed plies deeper than the previous one
+    if (previousIteration->nodes > 0 && depthSpeed > 0) {
+        stats.branchingFactor = pow((double)stats.nodes / previousIteration->nodes, 1.0 / depthSpeed);
+    }
+    stats.firstMoveCutoffRate = stats.cutoffs > 0 ? (double)stats.firstMoveCutoffs / stats.cutoffs : 0;
+    stats.branchFillAverage = stats.branchFills > 0 ? (double)stats.branchFillMoves / stats.branchFills : 0;
+    return stats;
+}
+
+// One JSON object per line, so that tuning scripts can read the iterations as they come
+static void printStats(int depth, SearchStats *stats) {
+    fprintf(stderr,
+            "{\"depth\":%d,\"ms\":%ld,\"nodes\":%ld,\"qnodes\":%ld,\"nps\":%ld,\"ebf\":%.3f,"
+            "\"cutoffs\":%ld,\"firstMoveCutoffRate\":%.3f,\"ttProbes\":%ld,\"ttHits\":%ld,\"ttCutoffs\":%ld,"
+            "\"branchFills\":%ld,\"branchFillAverage\":%.2f,\"researches\":%ld}\n",
+            depth, stats->ms, stats->nodes, stats->qnodes, stats->nps, stats->branchingFactor,
+            stats->cutoffs, stats->firstMoveCutoffRate, stats->ttProbes, stats->ttHits, stats->ttCutoffs,
+            stats->branchFills, stats->branchFillAverage, stats->researches);
+}
+
+// Stable insertion sort of the root moves by score, best first, root move lists are short
+static void sortRootMoves(Move *moves, int *scores, int size) {
+    for (int i = 1; i < size; i++) {
+        Move m = moves[i];
+        int score = scores[i];
+        int j = i - 1;
+        while (j >= 0 && scores[j] < score) {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+            j--;
+        }
+        moves[j + 1] = m;
+        scores[j + 1] = score;
+    }
+}
+
+// Prints a score as centipawns, or as the number of moves to mate, negative when being mated
+static void printScore(int score) {
+    if (score >= MATE_BOUND) {
+        printf("mate %d", (MATE_SCORE - score + 1) / 2);
+    } else if (score <= -MATE_BOUND) {
+        printf("mate -%d", (MATE_SCORE + score) / 2);
     } else {
-        int minEval = INT_MAX;
-        for (int i = 0; i < movesSize; i++) {
-
-            Move move = moves[i];
-
-            ChessBoard newBoard;
-            ChessBoardPlayMove(&newBoard, oldBoard, move);
-
-            int eval;
-            // Rerun the heuristic if the depth is 0 and the move is a capture
-            if (newBoard.depth == 0 && (oldBoard->squares[move.to] != EMPTY_PIECE)) {
-                newBoard.depth = 1;
-                eval = minimax(l, &newBoard, dict, alpha, beta, true, startTime, timeLimit, mustFinish);
-            } else if (newBoard.depth == 0 && scores != NULL) {
-                // Reuse the score we already calculated during sorting
-                eval = scores[i];
-            } else {
-                eval = minimax(l, &newBoard, dict, alpha, beta, true, startTime, timeLimit, mustFinish);
+        printf("%d", score);
+    }
+}
+
+/*
+ * Searches every root move to depth within (alpha, beta), the first one with the whole window and
+ * the others with a zero window first, stopping at the first move reaching beta. line receives
+ * the best line, whose score is only a bound if it falls outside the window.
+ */
+static void searchRoot(SearchWorker *worker, Move *moves, int *moveScores, int movesSize, int depth, int alpha, int beta, SearchLine *line) {
+    SearchThread *thread = &worker->thread;
+    ChessBoard *boardPtr = &worker->board;
+    int rootDepth = boardPtr->depth;
+    *line = (SearchLine){.score = -SCORE_INFINITE, .length = 0, .depth = depth};
+
+    // Every root move's line starts at ply 1
+    for (int i = 0; i < movesSize; i++) {
+        Move move = moves[i];
+
+        Undo undo;
+        ChessBoardMakeMove(boardPtr, move, &undo);
+        boardPtr->depth = depth;
+
+        int moveVal;
+        if (i == 0) {
+            moveVal = -negamax(worker->l, boardPtr, worker->dict, -beta, -alpha, thread);
+        } else {
+            moveVal = -negamax(worker->l, boardPtr, worker->dict, -alpha - 1, -alpha, thread);
+            if (moveVal > alpha && moveVal < beta && !thread->aborted) {
+                moveVal = -negamax(worker->l, boardPtr, worker->dict, -beta, -alpha, thread);
             }
-            
-            minEval = (eval < minEval) ? eval : minEval;
-            beta = (beta < eval) ? beta : eval;
-            if (beta <= alpha){
-                break; // Alpha-beta pruning
+        }
+        ChessBoardUnmakeMove(boardPtr, &undo);
+        boardPtr->depth = rootDepth;
+        if (thread->aborted) {
+            return;
+        }
+        moveScores[i] = moveVal;
+
+        if (moveVal > line->score) {
+            line->score = moveVal;
+            line->moves[0] = move;
+            memcpy(&line->moves[1], thread->pv[1], thread->pvLength[1] * sizeof(Move));
+            line->length = thread->pvLength[1] + 1;
+            if (moveVal >= beta) {
+                // Searched first when the window is widened
+                memmove(&moves[1], &moves[0], i * sizeof(Move));
+                memmove(&moveScores[1], &moveScores[0], i * sizeof(int));
+                moves[0] = move;
+                moveScores[0] = moveVal;
+                return;
             }
+            alpha = (alpha > moveVal) ? alpha : moveVal;
         }
-        free(scores); // Free allocated memory
-        final_score = minEval;
     }
+}
 
-    // update the dictionary with the final score
-    if (dict->zobrist != NULL) {
-        install_board(dict, oldBoard, final_score, oldBoard->depth);
+/*
+ * Searches the root moves to depth within an aspiration window around the score of the previous
+ * iteration's line, widened on the side it fails until the score falls inside. Returns the
+ * number of re-searches.
+ */
+static int aspirationSearch(SearchWorker *worker, Move *moves, int *moveScores, int movesSize, int depth, SearchLine *previous, SearchLine *line) {
+    int delta = searchConfig.aspirationWindow;
+    int alpha = -SCORE_INFINITE;
+    int beta = SCORE_INFINITE;
+    if (delta > 0 && previous->depth >= 0 && previous->length > 0 && previous->score > -MATE_BOUND && previous->score < MATE_BOUND) {
+        alpha = previous->score - delta;
+        beta = previous->score + delta;
+    }
+    int researches = 0;
+    while (true) {
+        searchRoot(worker, moves, moveScores, movesSize, depth, alpha, beta, line);
+        if (worker->thread.aborted || (line->score > alpha && line->score < beta)) {
+            return researches;
+        }
+        delta *= 2;
+        if (line->score <= alpha) {
+            alpha = (line->score - delta > -SCORE_INFINITE) ? line->score - delta : -SCORE_INFINITE;
+        } else {
+            beta = (line->score + delta < SCORE_INFINITE) ? line->score + delta : SCORE_INFINITE;
+        }
+        researches++;
+        count(&worker->thread.counters.researches, 1);
     }
-
-    return final_score;
 }
 
-// Update bestMove function to use the scores from sortMoves
-Move bestMove(LookupTable l, ChessBoard *boardPtr, Dictionary *dict, int minDepth, int timeLimit, int depth_speed, bool verbose) {
-    clock_t startTime = clock();
-    int bestVal = boardPtr->turn == White ? INT_MAX : INT_MIN;
-    Move bestMove;
-    int depthFrontier = boardPtr->depth;
+/*
+ * Iterative deepening loop run by every thread of a Lazy SMP search. Helpers start one ply
+ * deeper on odd ids so the threads spread over neighbouring depths and fill the shared
+ * dictionary for each other. Helpers ignore the clock and run until the main thread stops them.
+ */
+static void *iterativeDeepening(void *arg) {
+    SearchWorker *worker = arg;
+    SearchThread *thread = &worker->thread;
+    ChessBoard *boardPtr = &worker->board;
+    int rootDepth = boardPtr->depth;
+    int depthFrontier = rootDepth + (thread->id % 2);
+
+    MoveList root;
+    BranchLegalMoves(worker->l, boardPtr, &root);
+
+    // The first iteration uses the regular move ordering, later ones the previous iteration's scores
+    Move ttMove = MOVE_NULL;
+    if (worker->dict->zobrist != NULL) {
+        nlist *np = lookup_board(worker->dict, boardPtr);
+        if (np != NULL) {
+            ttMove = np->move;
+        }
+    }
+    MoveOrderScore(&thread->order, boardPtr, &root, ttMove, 0);
+    sortRootMoves(root.moves, root.scores, root.size);
 
-    Branch branches[BRANCHES_SIZE];
-    int branchesSize = BranchFill(l, boardPtr, branches);
-    Move moves[MOVES_SIZE];
-    int movesSize = BranchExtract(branches, branchesSize, moves);
-    int* moveScores = sortMoves(moves, movesSize, boardPtr, l, dict);
-    
-    while (
-        (((clock() - startTime) * 1000)) <= timeLimit*CLOCKS_PER_SEC
-        || depthFrontier <= minDepth
-    ) {
-
-        int tempBestVal = boardPtr->turn == White ? INT_MAX : INT_MIN;
-        Move tempBestMove;
-        for (int i = 0; i < movesSize; i++) {
-            Move move = moves[i];
-            
-            ChessBoard newBoard;
-            ChessBoardPlayMove(&newBoard, boardPtr, move);
-            newBoard.depth = depthFrontier;
-            
-            int moveVal;
-            // If it's the first iteration, we can use the score from the sort
-            if (depthFrontier == boardPtr->depth && newBoard.depth == 0) {
-                moveVal = moveScores[i];
-            } else {
-                // Main call of minimax
-                moveVal = minimax(l, &newBoard, dict, INT_MIN, INT_MAX, newBoard.turn, startTime, timeLimit, depthFrontier <= minDepth);
-            }
+    for (int i = 0; i < worker->multiPv; i++) {
+        worker->lines[i] = (SearchLine){.score = -SCORE_INFINITE, .length = 0, .depth = -1};
+    }
+    // Without legal moves the line stays empty with a null move, reported as such
+    worker->lines[0].moves[0] = MOVE_NULL;
+    if (root.size > 0) {
+        worker->lines[0].moves[0] = root.moves[0];
+        worker->lines[0].length = 1;
+    }
+    if (thread->id == 0) {
+        publishLines(worker->search, worker->lines, worker->multiPv); // Played if no iteration completes in time
+    }
 
-            if ((moveVal > tempBestVal && newBoard.turn == White) || (moveVal < tempBestVal && newBoard.turn == Black)) {
-                tempBestMove = move;
-                tempBestVal = moveVal;
+    long lastIterationMs = 0;
+    long previousIterationMs = 0;
+    SearchStats iterationTotal = totalStats(worker->workers, worker->threads);
+    SearchLine *best = &worker->lines[0];
+    while (root.size > 0) {
+        thread->mustFinish = thread->id > 0 || depthFrontier <= worker->minDepth;
+        if (searchAborted(thread)) {
+            break;
+        }
+        // Deeper iterations would only hit the ply limit, and the dictionary keeps depths in a byte. Pondering stops here too.
+        if (depthFrontier >= MAX_PLY) {
+            break;
+        }
+        // The main thread only starts an iteration it expects to finish in time
+        if (!thread->mustFinish && best->depth >= 0 &&
+            !TimeManagerStartIteration(thread->time, lastIterationMs, previousIterationMs)) {
+            break;
+        }
+        long iterationStart = TimeManagerElapsed(thread->time);
+
+        // Each line is the best of the root moves the lines before it left out, found by one search sharing the dictionary
+        int linesSize = (worker->multiPv < root.size) ? worker->multiPv : root.size;
+        SearchLine lines[MAX_MULTI_PV];
+        int researches = 0;
+        for (int i = 0; i < linesSize && !thread->aborted; i++) {
+            researches += aspirationSearch(worker, &root.moves[i], &root.scores[i], root.size - i, depthFrontier, &worker->lines[i], &lines[i]);
+            if (!thread->aborted) {
+                // The best moves go first in the next iteration
+                sortRootMoves(&root.moves[i], &root.scores[i], root.size - i);
             }
         }
 
-        if ((((clock() - startTime) * 1000)) <= timeLimit*CLOCKS_PER_SEC || depthFrontier <= minDepth) {
-            bestMove = tempBestMove;
-            bestVal = tempBestVal;
-            if (verbose) {
+        if (!thread->aborted) {
+            // A later line may still score better than an earlier one, the search being unstable
+            for (int i = 1; i < linesSize; i++) {
+                SearchLine line = lines[i];
+                int j = i - 1;
+                while (j >= 0 && lines[j].score < line.score) {
+                    lines[j + 1] = lines[j];
+                    j--;
+                }
+                lines[j + 1] = line;
+            }
+            for (int i = 0; i < linesSize; i++) {
+                root.moves[i] = lines[i].moves[0];
+                root.scores[i] = lines[i].score;
+            }
+            for (int i = linesSize; i < worker->multiPv; i++) {
+                lines[i] = (SearchLine){.score = -SCORE_INFINITE, .length = 0, .depth = depthFrontier};
+            }
+
+            previousIterationMs = lastIterationMs;
+            lastIterationMs = TimeManagerElapsed(thread->time) - iterationStart;
+            SearchStats total = totalStats(worker->workers, worker->threads);
+            for (int i = 0; i < linesSize; i++) {
+                lines[i].nodes = total.nodes;
+            }
+            lines[0].stats = iterationStats(&total, &iterationTotal, &best->stats, lastIterationMs, worker->depth_speed);
+            iterationTotal = total;
+            memcpy(worker->lines, lines, worker->multiPv * sizeof(SearchLine));
+            // Only the main thread has every line when more than one is asked for
+            if (thread->id == 0 || worker->search->limits.multiPv == 1) {
+                publishLines(worker->search, worker->lines, worker->multiPv);
+            }
+            if (worker->stats && thread->id == 0) {
+                printStats(depthFrontier, &best->stats);
+            }
+            // A pondering search only reports once its move is played, like a search started then
+            if (worker->verbose && thread->id == 0 && !TimeManagerPondering(thread->time)) {
+                long ms = TimeManagerElapsed(thread->time);
+                long nodes = best->nodes;
                 printf("Depth: %d\n", depthFrontier);
-                printf("Best move: %s\n", moveToString(bestMove));
-                printf("Best score: %d\n", bestVal);
+                printf("Best move: %s\n", moveToString(best->moves[0]));
+                printf("Best score: ");
+                printScore(best->score);
+                printf("\nPV:");
+                for (int i = 0; i < best->length; i++) {
+                    printf(" %s", moveToString(best->moves[i]));
+                }
+                for (int i = 1; i < linesSize; i++) {
+                    printf("\nPV %d (", i + 1);
+                    printScore(lines[i].score);
+                    printf("):");
+                    for (int j = 0; j < lines[i].length; j++) {
+                        printf(" %s", moveToString(lines[i].moves[j]));
+                    }
+                }
+                printf("\nRe-searches: %d\n", researches);
+                printf("Time: %ld ms, Nodes: %ld, NPS: %ld\n", ms, nodes, ms > 0 ? nodes * 1000 / ms : nodes);
             }
         }
-        depthFrontier+=depth_speed;
-        
-        if (tempBestVal == INT_MAX || tempBestVal == INT_MIN) {
+        depthFrontier+=worker->depth_speed;
+
+        if (!thread->aborted && (best->score >= MATE_BOUND || best->score <= -MATE_BOUND)) {
             break;
         }
-        
+
     }
-    
-    free(moveScores); // Free allocated memory
 
-    if (bestVal == INT_MIN) {
-        bestMove = moves[0];
+    return NULL;
+}
+
+// Makes lines the search's current result if they are deeper
+static void publishLines(Search *search, SearchLine *lines, int linesSize) {
+    pthread_mutex_lock(&search->lock);
+    if (lines[0].depth > search->lines[0].depth || search->lines[0].length == 0) {
+        memcpy(search->lines, lines, linesSize * sizeof(SearchLine));
+    }
+    pthread_mutex_unlock(&search->lock);
+}
+
+// Runs a Lazy SMP search, leaving the lines of the thread which completed the deepest iteration in search->lines
+static void lazySmpSearch(Search *search) {
+    ChessBoard *boardPtr = &search->board;
+    Dictionary *dict = search->dict;
+    int threads = search->limits.threads;
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
     }
 
-    // update the dictionary with the final score
     if (dict->zobrist != NULL) {
-        install_board(dict, boardPtr, bestVal, depthFrontier);
+        age_dictionary(dict);
+    }
+    SearchWorker *workers = malloc(threads * sizeof(SearchWorker));
+    pthread_t helpers[MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        SearchWorker *worker = &workers[i];
+        worker->thread.id = i;
+        atomic_init(&worker->thread.nodes, 0);
+        worker->thread.counters = (SearchCounters){0};
+        worker->thread.time = &search->time;
+        worker->thread.mustFinish = false;
+        worker->thread.stop = &search->stop;
+        worker->thread.aborted = false;
+        worker->thread.rootPly = boardPtr->moves_completed;
+        memset(worker->thread.pvLength, 0, sizeof(worker->thread.pvLength));
+        MoveOrderClear(&worker->thread.order);
+        worker->search = search;
+        worker->workers = workers;
+        worker->l = search->l;
+        ChessBoardCopy(&worker->board, &worker->history, boardPtr);
+        worker->dict = dict;
+        worker->minDepth = search->limits.minDepth;
+        worker->depth_speed = search->limits.depth_speed;
+        worker->verbose = search->limits.verbose;
+        worker->stats = search->limits.stats;
+        worker->multiPv = (i == 0) ? search->limits.multiPv : 1;
+        worker->threads = threads;
+    }
+
+    for (int i = 1; i < threads; i++) {
+        pthread_create(&helpers[i], NULL, iterativeDeepening, &workers[i]);
+    }
+    iterativeDeepening(&workers[0]);
+    atomic_store(&search->stop, true);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(helpers[i], NULL);
+    }
+
+    pthread_mutex_lock(&search->lock);
+    search->lines[0].nodes = totalNodes(workers, threads);
+    SearchLine *best = &search->lines[0];
+    pthread_mutex_unlock(&search->lock);
+
+    if (search->limits.verbose && !TimeManagerPondering(&search->time)) {
+        long ms = TimeManagerElapsed(&search->time);
+        printf("Threads: %d, Depth reached: %d, Time: %ld ms, Nodes: %ld, NPS: %ld\n", threads, best->depth, ms, best->nodes, ms > 0 ? best->nodes * 1000 / ms : best->nodes);
     }
 
-    return bestMove;
+    // update the dictionary with the final score, every root move is searched with a full window
+    if (dict->zobrist != NULL && best->depth >= 0) {
+        install_bound(dict, boardPtr, scoreToDict(best->score, 0, boardPtr->turn), best->depth, BOUND_EXACT, best->moves[0]);
+    }
+
+    free(workers);
+}
+
+static void *searchMain(void *arg) {
+    Search *search = arg;
+    lazySmpSearch(search);
+    atomic_store(&search->done, true);
+    return NULL;
 }
 
-// Modified function to return the scores array
-int* sortMoves(Move *moves, int size, ChessBoard *board, LookupTable l, Dictionary *dict) {
-    int* scores = malloc(size * sizeof(int));
-    ChessBoard *newBoard = malloc(sizeof(ChessBoard));
-    for (int i = 0; i < size; i++) {
-        ChessBoardPlayMove(newBoard, board, moves[i]);
-        scores[i] = heuristic(l, newBoard, dict);
+Search *SearchStart(LookupTable l, ChessBoard *boardPtr, Dictionary *dict, SearchLimits limits) {
+    Search *search = malloc(sizeof(Search));
+    search->l = l;
+    ChessBoardCopy(&search->board, &search->history, boardPtr);
+    search->dict = dict;
+    search->limits = limits;
+    atomic_init(&search->stop, false);
+    atomic_init(&search->done, false);
+    pthread_mutex_init(&search->lock, NULL);
+    if (search->limits.multiPv < 1) {
+        search->limits.multiPv = 1;
+    } else if (search->limits.multiPv > MAX_MULTI_PV) {
+        search->limits.multiPv = MAX_MULTI_PV;
+    }
+    for (int i = 0; i < search->limits.multiPv; i++) {
+        search->lines[i] = (SearchLine){.score = -SCORE_INFINITE, .length = 0, .depth = -1, .nodes = 0};
     }
-    free(newBoard);
-    
-    mergeSort(scores, moves, 0, size - 1);
-    return scores;
+    if (limits.ponder) {
+        TimeManagerPonder(&search->time);
+    } else {
+        TimeManagerStart(&search->time, limits.tc, boardPtr->turn);
+    }
+    pthread_create(&search->thread, NULL, searchMain, search);
+    return search;
+}
+
+bool SearchPoll(Search *search, SearchLine *lines) {
+    bool done = atomic_load(&search->done);
+    pthread_mutex_lock(&search->lock);
+    memcpy(lines, search->lines, search->limits.multiPv * sizeof(SearchLine));
+    pthread_mutex_unlock(&search->lock);
+    return done;
+}
+
+void SearchStop(Search *search) {
+    atomic_store(&search->stop, true);
 }
 
-void mergeSort(int *scores, Move *moves, int l, int r) {
-    if (l < r) {
-        int m = l + (r - l) / 2;
-        mergeSort(scores, moves, l, m);
-        mergeSort(scores, moves, m + 1, r);
-        merge(scores, moves, l, m, r);
+void SearchPonderHit(Search *search, TimeControl tc) {
+    TimeManagerPonderHit(&search->time, tc, search->board.turn);
+}
+
+Move SearchWait(Search *search, SearchLine *lines) {
+    pthread_join(search->thread, NULL);
+    Move move = search->lines[0].moves[0];
+    if (lines != NULL) {
+        memcpy(lines, search->lines, search->limits.multiPv * sizeof(SearchLine));
     }
+    pthread_mutex_destroy(&search->lock);
+    free(search);
+    return move;
 }
 
-void merge(int *scores, Move *moves, int l, int m, int r) {
-    int n1 = m - l + 1;
-    int n2 = r - m;
+Move bestMove(LookupTable l, ChessBoard *boardPtr, Dictionary *dict, int minDepth, TimeControl tc, int depth_speed, bool verbose, int threads, SearchLine *line) {
+    SearchLimits limits = {.tc = tc, .minDepth = minDepth, .depth_speed = depth_speed, .threads = threads, .verbose = verbose, .ponder = false};
+    return SearchWait(SearchStart(l, boardPtr, dict, limits), line);
+}
 
-    int L[n1], R[n2];
-    Move Lm[n1], Rm[n2];
-    for (int i = 0; i < n1; i++) {
-        L[i] = scores[l + i];
-        Lm[i] = moves[l + i];
+bool ponderStart(PonderSearch *ps, LookupTable l, ChessBoard *boardPtr, Dictionary *dict, int minDepth, int depth_speed, int threads, bool verbose) {
+    if (dict->zobrist == NULL) {
+        return false;
     }
-    for (int j = 0; j < n2; j++) {
-        R[j] = scores[m + 1 + j];
-        Rm[j] = moves[m + 1 + j];
+    nlist *np = lookup_board(dict, boardPtr);
+    if (np == NULL || ChessBoardIsNullMove(np->move)) {
+        return false;
     }
+    Move predicted = np->move;
 
+    // The stored move may come from another position sharing the bucket, so it must be legal here
+    MoveList legal;
+    BranchLegalMoves(l, boardPtr, &legal);
     int i = 0;
-    int j = 0;
-    int k = l;
-    while (i < n1 && j < n2) {
-        if (L[i] >= R[j]) {
-            scores[k] = L[i];
-            moves[k] = Lm[i];
-            i++;
-        } else {
-            scores[k] = R[j];
-            moves[k] = Rm[j];
-            j++;
-        }
-        k++;
+    while (i < legal.size && legal.moves[i] != predicted) {
+        i++;
+    }
+    if (i == legal.size) {
+        return false;
     }
 
-    while (i < n1) {
-        scores[k] = L[i];
-        moves[k] = Lm[i];
-        i++;
-        k++;
+    ps->expected = predicted;
+    ChessBoardPlayMove(&ps->board, boardPtr, ps->expected);
+    ps->board.depth = boardPtr->depth;
+    SearchLimits limits = {.minDepth = minDepth, .depth_speed = depth_speed, .threads = threads, .verbose = verbose, .ponder = true};
+    ps->search = SearchStart(l, &ps->board, dict, limits);
+    return true;
+}
+
+Search *ponderHit(PonderSearch *ps, TimeControl tc) {
+    SearchPonderHit(ps->search, tc);
+    return ps->search;
+}
+
+void ponderStop(PonderSearch *ps) {
+    SearchStop(ps->search);
+    SearchWait(ps->search, NULL);
+}
+
+void benchmarkThreads(LookupTable l, Dictionary *dict, const char *filename, int depth, int maxThreads) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return;
     }
 
-    while (j < n2) {
-        scores[k] = R[j];
-        moves[k] = Rm[j];
-        j++;
-        k++;
+#ifdef PSEUDO_LEGAL
+    printf("Move generation: pseudo-legal\n");
+#else
+    printf("Move generation: legal\n");
+#endif
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = 0;
+        // Every line ends with the perft depth and node count, which would otherwise be read as the move counters
+        for (int field = 0; field < 2; field++) {
+            char *last = strrchr(line, ' ');
+            if (last != NULL) {
+                *last = 0;
+            }
+        }
+        if (line[0] == 0) {
+            continue;
+        }
+        printf("Position: %s\n", line);
+
+        long baseMs = 0;
+        for (int threads = 1; threads <= maxThreads; threads = (threads * 2 > maxThreads && threads < maxThreads) ? maxThreads : threads * 2) {
+            if (dict->zobrist != NULL) {
+                clear_dictionary(dict); // Every run starts from an empty table
+            }
+            ChessBoard cb = ChessBoardNew(line, 1);
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            SearchLine result;
+            bestMove(l, &cb, dict, depth, TimeControlFixed(0), 1, false, threads, &result); // Stops as soon as depth is reached
+            struct timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            long ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+            long nodes = result.nodes;
+            if (threads == 1) {
+                baseMs = ms;
+            }
+            printf("Threads: %2d  Time to depth %d: %7ld ms  Nodes: %10ld  NPS: %9ld  Speedup: %.2f\n",
+                   threads, depth, ms, nodes, ms > 0 ? nodes * 1000 / ms : nodes, ms > 0 ? (double)baseMs / ms : 1.0);
+        }
     }
-}
\ No newline at end of file
+
+    fclose(file);
+}
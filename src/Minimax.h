@@ -2,14 +2,189 @@
 #define MINIMAX_ALPHA_BETA_H
 
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <time.h>
 
+#include "MoveOrder.h"
+#include "TimeManager.h"
 
+#define MAX_THREADS 64
+#define MAX_MULTI_PV 16
+#define MATE_SCORE 30000                  // Score of mating at the root, mates further away score MATE_SCORE - plies
+#define MATE_BOUND (MATE_SCORE - MAX_PLY) // Scores at least this far from zero are mates
+#define SCORE_INFINITE (MATE_SCORE + 1)   // Beyond any score, for the initial window
 
-// Minimax algorithm with alpha-beta pruning
-int minimax(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, bool maximizingPlayer, clock_t startTime, int timeLimit, bool mustFinish);
+// Statistics counted by one thread, only written by their owner and summed over the threads between iterations
+typedef struct {
+    atomic_long qnodes;           // Quiescence nodes, also counted in nodes
+    atomic_long ttProbes;         // Dictionary lookups of the main search
+    atomic_long ttHits;           // Lookups which found the position
+    atomic_long ttCutoffs;        // Hits whose score settled the node
+    atomic_long cutoffs;          // Nodes of the main search which failed high
+    atomic_long firstMoveCutoffs; // Those which failed high on their first move
+    atomic_long branchFills;      // BranchFill calls generating every legal move
+    atomic_long branchFillMoves;  // Moves those calls generated
+    atomic_long researches;       // Root searches repeated because the score fell outside the aspiration window
+} SearchCounters;
 
-// Function to find the best move within the given depth and time limits
-Move bestMove(LookupTable l, ChessBoard *board, Dictionary *dict, int minDepth, int timeLimit, int depth_speed, bool verbose);
+// Search state owned by one thread of a Lazy SMP search. All threads share the dictionary.
+typedef struct {
+    int id;                    // 0 is the main thread, helpers are numbered from 1
+    atomic_long nodes;         // Nodes visited by this thread, only written by its owner
+    SearchCounters counters;
+    TimeManager *time;         // Time budget shared by all threads, only the main thread reads the clock
+    bool mustFinish;           // Ignore the time limit for the current iteration
+    atomic_bool *stop;         // Raised by the main thread once it has picked its move
+    bool aborted;              // Set once this thread has seen stop or the hard limit, the scores it returns since are meaningless
+    int rootPly;               // moves_completed of the root, to get the ply of a node
+    MoveOrder order;           // Killers and history of this thread
+    Move pv[MAX_PLY][MAX_PLY]; // Triangular principal variation table, pv[ply] is the best line found from ply
+    int pvLength[MAX_PLY];
+} SearchThread;
+
+/*
+ * Statistics of one iteration, counted over all the threads of the search since the previous
+ * iteration of the thread which completed it.
+ */
+typedef struct {
+    long ms;                    // Time the iteration took, re-searches included
+    long nodes;
+    long qnodes;
+    long nps;
+    double branchingFactor;     // Effective branching factor per ply, from the nodes of the previous iteration
+    double firstMoveCutoffRate; // Share of the cutoffs made by the first move searched
+    long ttProbes;
+    long ttHits;
+    long ttCutoffs;
+    double branchFillAverage;   // Legal moves per node
+    long cutoffs;
+    long firstMoveCutoffs;
+    long branchFills;
+    long branchFillMoves;
+    long researches;            // Aspiration window re-searches of the root
+} SearchStats;
+
+// Principal variation of a completed iteration, scored from the side to move's point of view
+typedef struct {
+    Move moves[MAX_PLY];
+    int length;
+    int score;
+    int depth;   // -1 until an iteration completes, moves[0] is then only the first legal move
+    long nodes;  // Nodes searched by all the threads when the line was found
+    SearchStats stats;
+} SearchLine;
+
+/*
+ * Reductions and forward pruning rules of the search, each with its own switch so that the
+ * nodes it saves can be measured. Margins are in centipawns per ply of remaining depth. The defaults are set in Minimax.c, changing them only affects
+ * searches started afterwards.
+ */
+typedef struct {
+    bool nullMove;             // Null move pruning
+    int nullMoveMinDepth;      // Shallowest remaining depth at which a null move is tried
+    int nullMoveReduction;     // Plies the null move search is reduced by, besides the null move itself
+    int nullMoveDepthDivisor;  // One more ply of reduction per nullMoveDepthDivisor plies of depth
+    bool lateMoveReductions;   // Late move reductions
+    int lmrMinDepth;           // Shallowest remaining depth at which late quiet moves are reduced
+    int lmrMinMoves;           // Moves searched at full depth before reductions start
+    double lmrBase;            // Quiet moves are reduced by lmrBase + log(depth) * log(move number) / lmrDivisor
+    double lmrDivisor;
+    bool reverseFutility;      // Nodes whose static evaluation beats the window by a margin return it
+    int reverseFutilityDepth;  // Deepest remaining depth at which reverse futility pruning applies
+    int reverseFutilityMargin; // Centipawns per ply of remaining depth
+    bool futility;             // Quiet moves of nodes whose static evaluation is a margin below the window are skipped
+    int futilityDepth;
+    int futilityMargin;
+    bool razoring;             // Nodes whose static evaluation is a margin below the window drop into quiescence
+    int razoringDepth;
+    int razoringMargin;
+    int aspirationWindow;      // Centipawns on each side of the previous iteration's score, 0 searches with the full window
+} SearchConfig;
+
+extern SearchConfig searchConfig;
+
+// Negamax with alpha-beta pruning and principal variation search, scored from the side to move's point of view
+int negamax(LookupTable l, ChessBoard *board, Dictionary *dict, int alpha, int beta, SearchThread *thread);
+
+/*
+ * Limits of a search: it stops once the time control runs out, after at least minDepth plies.
+ * A pondering search has no time limit until SearchPonderHit.
+ */
+typedef struct {
+    TimeControl tc;
+    int minDepth;
+    int depth_speed;
+    int threads;
+    bool verbose;  // Prints every iteration and a summary to stdout
+    bool stats;    // Prints the statistics of every iteration as a JSON line on stderr
+    int multiPv;   // Best root moves searched each with its own line, 1 if 0, at most MAX_MULTI_PV
+    bool ponder;
+} SearchLimits;
+
+/*
+ * Search running on a background thread, started by SearchStart. Its deepest completed line is
+ * read with SearchPoll, and SearchWait joins the thread and frees the handle.
+ */
+typedef struct {
+    pthread_t thread;
+    LookupTable l;
+    ChessBoard board;
+    GameHistory history; // The board's own copy of the moves played, the game may go on meanwhile
+    Dictionary *dict;
+    SearchLimits limits;
+    TimeManager time;
+    atomic_bool stop;  // Checked by every thread of the search, set by SearchStop or when time runs out
+    atomic_bool done;
+    pthread_mutex_t lock;  // Guards lines
+    SearchLine lines[MAX_MULTI_PV]; // limits.multiPv lines of the deepest completed iteration, best first
+} Search;
+
+// Starts searching board on a background thread and returns immediately
+Search *SearchStart(LookupTable l, ChessBoard *board, Dictionary *dict, SearchLimits limits);
+
+/*
+ * Copies the limits.multiPv lines of the deepest iteration completed so far, best first, and
+ * returns true once the search has finished. Lines past the number of legal moves are empty.
+ */
+bool SearchPoll(Search *search, SearchLine *lines);
+
+// Asks the search to finish, it keeps the deepest line completed so far
+void SearchStop(Search *search);
+
+// Starts the time control of a pondering search
+void SearchPonderHit(Search *search, TimeControl tc);
+
+// Waits for the search to finish, frees it and returns its best move. Its final lines are copied to lines if not NULL, as by SearchPoll.
+Move SearchWait(Search *search, SearchLine *lines);
+
+// Function to find the best move within the given depth and time control, using the given number of threads. Its principal variation is copied to line if not NULL.
+Move bestMove(LookupTable l, ChessBoard *board, Dictionary *dict, int minDepth, TimeControl tc, int depth_speed, bool verbose, int threads, SearchLine *line);
+
+/*
+ * Search of the position after the opponent's expected reply, run on a background thread while
+ * the opponent thinks. It has no time limit until ponderHit, and fills the shared dictionary
+ * either way.
+ */
+typedef struct {
+    Move expected;       // Reply the search assumes, the best move stored for the position
+    ChessBoard board;    // Position after the expected reply
+    Search *search;
+} PonderSearch;
+
+/*
+ * Starts pondering on the expected reply to board, returns false if the dictionary has no legal move to expect.
+ * A verbose search stays silent until ponderHit, then reports like one started by SearchStart.
+ */
+bool ponderStart(PonderSearch *ps, LookupTable l, ChessBoard *board, Dictionary *dict, int minDepth, int depth_speed, int threads, bool verbose);
+
+// The expected reply was played: the search goes on within the time control, and is returned to be polled and waited for
+Search *ponderHit(PonderSearch *ps, TimeControl tc);
+
+// Another move was played: the search is stopped, only the entries it stored in the dictionary remain
+void ponderStop(PonderSearch *ps);
+
+// Searches every position in the given file to a fixed depth with 1..maxThreads threads and reports time-to-depth and NPS
+void benchmarkThreads(LookupTable l, Dictionary *dict, const char *filename, int depth, int maxThreads);
 
 #endif // MINIMAX_ALPHA_BETA_H
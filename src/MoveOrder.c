@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "Branch.h"
+#include "MoveOrder.h"
+#include "See.h"
+
+// Ordering score bands, each one above everything in the bands below
+#define TT_SCORE (1 << 30)
+#define CAPTURE_SCORE (1 << 20)
+#define KILLER_SCORE (1 << 19)
+
+static const int victimValues[] = {1, 0, 3, 3, 5, 9}; // Indexed by Type, a king is never captured
+
+static void updateHistory(int *h, int bonus);
+static bool isKiller(MoveOrder *mo, int ply, Move m);
+
+void MoveOrderClear(MoveOrder *mo)
+{
+  memset(mo, 0, sizeof(MoveOrder));
+}
+
+int MoveOrderIsTactical(ChessBoard *cb, Move m)
+{
+  return cb->squares[MOVE_TO(m)] != EMPTY_PIECE || MOVE_FLAGS(m) == MOVE_EN_PASSANT || MOVE_IS_PROMOTION(m);
+}
+
+int MoveOrderMvvLva(ChessBoard *cb, Move m)
+{
+  Piece victim = cb->squares[MOVE_TO(m)];
+  Type moving = GET_TYPE(cb->squares[MOVE_FROM(m)]);
+  int value = (victim == EMPTY_PIECE) ? 0 : victimValues[GET_TYPE(victim)];
+  if (MOVE_FLAGS(m) == MOVE_EN_PASSANT)
+    value = victimValues[Pawn];
+  if (MOVE_IS_PROMOTION(m))
+    value += victimValues[MOVE_PROMOTED(m)];
+  return value * 16 - victimValues[moving];
+}
+
+void MoveOrderScore(MoveOrder *mo, ChessBoard *cb, MoveList *list, Move ttMove, int ply)
+{
+  int *scores = list->scores;
+  for (int i = 0; i < list->size; i++)
+  {
+    Move m = list->moves[i];
+    if (m == ttMove)
+      scores[i] = TT_SCORE;
+    else if (MoveOrderIsTactical(cb, m))
+      scores[i] = CAPTURE_SCORE + MoveOrderMvvLva(cb, m);
+    else if (ply < MAX_PLY && m == mo->killers[ply][0])
+      scores[i] = KILLER_SCORE + 1;
+    else if (ply < MAX_PLY && m == mo->killers[ply][1])
+      scores[i] = KILLER_SCORE;
+    else
+      scores[i] = mo->history[cb->turn][MOVE_FROM(m)][MOVE_TO(m)];
+  }
+}
+
+Move MoveOrderPick(MoveList *list, int index)
+{
+  Move *moves = list->moves;
+  int *scores = list->scores;
+  int best = index;
+  for (int i = index + 1; i < list->size; i++)
+  {
+    if (scores[i] > scores[best])
+      best = i;
+  }
+
+  Move m = moves[best];
+  int score = scores[best];
+  moves[best] = moves[index];
+  scores[best] = scores[index];
+  moves[index] = m;
+  scores[index] = score;
+  return m;
+}
+
+void MovePickerInit(MovePicker *mp, LookupTable l, ChessBoard *cb, MoveOrder *mo, Move ttMove, int ply, bool inCheck)
+{
+  mp->l = l;
+  mp->cb = cb;
+  mp->mo = mo;
+  mp->branchesSize = inCheck ? BranchFillEvasions(l, cb, mp->branches) : BranchFill(l, cb, mp->branches);
+  mp->list.size = 0;
+  mp->index = 0;
+  mp->badSize = 0;
+  mp->stage = STAGE_TT;
+  // The dictionary move may come from another position sharing the bucket, so it is only kept if it is legal here
+  mp->ttMove = BranchContains(mp->branches, mp->branchesSize, ttMove) ? ttMove : MOVE_NULL;
+  mp->ply = ply;
+}
+
+int MovePickerCount(MovePicker *mp)
+{
+  return BranchCount(mp->branches, mp->branchesSize);
+}
+
+bool MovePickerNext(MovePicker *mp, Move *move)
+{
+  ChessBoard *cb = mp->cb;
+  switch (mp->stage)
+  {
+  case STAGE_TT:
+    mp->stage = STAGE_CAPTURES_INIT;
+    if (!ChessBoardIsNullMove(mp->ttMove))
+    {
+      *move = mp->ttMove;
+      return true;
+    }
+    // fall through
+  case STAGE_CAPTURES_INIT:
+    mp->list.size = BranchExtractTactical(cb, mp->branches, mp->branchesSize, mp->list.moves);
+    mp->index = 0;
+    for (int i = 0; i < mp->list.size; i++)
+      mp->list.scores[i] = MoveOrderMvvLva(cb, mp->list.moves[i]);
+    mp->stage = STAGE_CAPTURES;
+    // fall through
+  case STAGE_CAPTURES:
+    while (mp->index < mp->list.size)
+    {
+      *move = MoveOrderPick(&mp->list, mp->index++);
+      if (*move == mp->ttMove)
+        continue;
+      if (SeeEvaluate(mp->l, cb, *move) < 0)
+        mp->bad[mp->badSize++] = *move; // Tried after the quiet moves
+      else
+        return true;
+    }
+    mp->stage = STAGE_KILLERS;
+    mp->index = 0;
+    // fall through
+  case STAGE_KILLERS:
+    while (mp->ply < MAX_PLY && mp->index < 2)
+    {
+      Move killer = mp->mo->killers[mp->ply][mp->index++];
+      if (mp->index == 2 && killer == mp->mo->killers[mp->ply][0])
+        continue;
+      if (!ChessBoardIsNullMove(killer) && killer != mp->ttMove && !MoveOrderIsTactical(cb, killer) &&
+          BranchContains(mp->branches, mp->branchesSize, killer))
+      {
+        *move = killer;
+        return true;
+      }
+    }
+    mp->stage = STAGE_QUIETS_INIT;
+    // fall through
+  case STAGE_QUIETS_INIT:
+    mp->list.size = BranchExtractQuiet(cb, mp->branches, mp->branchesSize, mp->list.moves);
+    mp->index = 0;
+    for (int i = 0; i < mp->list.size; i++)
+      mp->list.scores[i] = mp->mo->history[cb->turn][MOVE_FROM(mp->list.moves[i])][MOVE_TO(mp->list.moves[i])];
+    mp->stage = STAGE_QUIETS;
+    // fall through
+  case STAGE_QUIETS:
+    while (mp->index < mp->list.size)
+    {
+      *move = MoveOrderPick(&mp->list, mp->index++);
+      if (*move != mp->ttMove && !isKiller(mp->mo, mp->ply, *move))
+        return true;
+    }
+    mp->stage = STAGE_BAD_CAPTURES;
+    mp->index = 0;
+    // fall through
+  case STAGE_BAD_CAPTURES:
+    if (mp->index < mp->badSize)
+    {
+      *move = mp->bad[mp->index++];
+      return true;
+    }
+    mp->stage = STAGE_DONE;
+    // fall through
+  case STAGE_DONE:
+    break;
+  }
+  return false;
+}
+
+// Killers are only handed out in their own stage if they are legal, so skipping them later is safe
+static bool isKiller(MoveOrder *mo, int ply, Move m)
+{
+  return ply < MAX_PLY && (m == mo->killers[ply][0] || m == mo->killers[ply][1]);
+}
+
+void MoveOrderUpdate(MoveOrder *mo, ChessBoard *cb, Move best, Move *tried, int triedSize, int depth, int ply)
+{
+  if (MoveOrderIsTactical(cb, best))
+    return;
+
+  if (ply < MAX_PLY && best != mo->killers[ply][0])
+  {
+    mo->killers[ply][1] = mo->killers[ply][0];
+    mo->killers[ply][0] = best;
+  }
+
+  int bonus = (depth * depth < HISTORY_MAX) ? depth * depth : HISTORY_MAX;
+  updateHistory(&mo->history[cb->turn][MOVE_FROM(best)][MOVE_TO(best)], bonus);
+  for (int i = 0; i < triedSize; i++)
+  {
+    if (!MoveOrderIsTactical(cb, tried[i]))
+      updateHistory(&mo->history[cb->turn][MOVE_FROM(tried[i])][MOVE_TO(tried[i])], -bonus);
+  }
+}
+
+// Moves h towards the bonus, the closer it already is to the limit the smaller the step
+static void updateHistory(int *h, int bonus)
+{
+  *h += bonus - *h * abs(bonus) / HISTORY_MAX;
+}
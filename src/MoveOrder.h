@@ -0,0 +1,110 @@
+#ifndef MOVEORDER_H
+#define MOVEORDER_H
+
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "Branch.h"
+
+#define MAX_PLY 128         // Deepest ply from the root that keeps killer moves
+#define HISTORY_MAX 16384   // History scores stay within [-HISTORY_MAX, HISTORY_MAX]
+
+/*
+ * Move ordering state of one search thread. Killers are quiet moves which caused a beta
+ * cutoff at the same ply, the butterfly history table scores quiet moves by color, from
+ * and to square, rewarding moves which caused cutoffs and penalising the ones tried before.
+ */
+typedef struct
+{
+  Move killers[MAX_PLY][2];
+  int history[2][BOARD_SIZE][BOARD_SIZE];
+} MoveOrder;
+
+// Stages of a MovePicker, in the order moves are handed out
+typedef enum
+{
+  STAGE_TT,
+  STAGE_CAPTURES_INIT,
+  STAGE_CAPTURES,
+  STAGE_KILLERS,
+  STAGE_QUIETS_INIT,
+  STAGE_QUIETS,
+  STAGE_BAD_CAPTURES,
+  STAGE_DONE
+} MovePickerStage;
+
+/*
+ * Hands out the legal moves of a position one at a time: the transposition table move, then
+ * captures and promotions by MVV-LVA, then killers, then quiet moves by history, then the
+ * captures losing material by static exchange evaluation, set aside in their stage. The legal
+ * moves are only generated as branches up front, each group of moves is extracted from them
+ * when its stage is reached, so a node which cuts off early never expands its quiet moves.
+ */
+typedef struct
+{
+  LookupTable l;
+  ChessBoard *cb;
+  MoveOrder *mo;
+  Branch branches[BRANCHES_SIZE];
+  int branchesSize;
+  MoveList list; // Moves of the current stage
+  int index;
+  Move bad[MOVES_SIZE]; // Losing captures, in the order they were set aside
+  int badSize;
+  MovePickerStage stage;
+  Move ttMove;  // Dictionary move, MOVE_NULL unless it is legal in this position
+  int ply;
+} MovePicker;
+
+/*
+ * Forgets all killers and history
+ */
+void MoveOrderClear(MoveOrder *mo);
+
+/*
+ * Returns true if the move captures a piece (including en passant) or promotes
+ */
+int MoveOrderIsTactical(ChessBoard *cb, Move m);
+
+/*
+ * Most valuable victim, least valuable attacker score of a tactical move. Promotions count
+ * as capturing the piece promoted to.
+ */
+int MoveOrderMvvLva(ChessBoard *cb, Move m);
+
+/*
+ * Gives each move of the list an ordering score: the transposition table move first, then captures by
+ * MVV-LVA, then killers, then quiet moves by history.
+ */
+void MoveOrderScore(MoveOrder *mo, ChessBoard *cb, MoveList *list, Move ttMove, int ply);
+
+/*
+ * Selects the best scored move of the list from index on, swaps it (and its score) into
+ * index and returns it. Picking one move at a time avoids sorting moves that are never
+ * searched because of a cutoff.
+ */
+Move MoveOrderPick(MoveList *list, int index);
+
+/*
+ * Generates the legal moves of a position as branches and starts handing them out, with the
+ * evasion generator if the side to move is in check
+ */
+void MovePickerInit(MovePicker *mp, LookupTable l, ChessBoard *cb, MoveOrder *mo, Move ttMove, int ply, bool inCheck);
+
+/*
+ * Returns the number of legal moves of the position
+ */
+int MovePickerCount(MovePicker *mp);
+
+/*
+ * Stores the next move in move, returns false once every move has been handed out
+ */
+bool MovePickerNext(MovePicker *mp, Move *move);
+
+/*
+ * Records that the quiet move best caused a beta cutoff at ply after the quiet moves
+ * tried[0..triedSize) failed to, with depth being the remaining depth of the node.
+ */
+void MoveOrderUpdate(MoveOrder *mo, ChessBoard *cb, Move best, Move *tried, int triedSize, int depth, int ply);
+
+#endif
@@ -36,15 +36,14 @@ OpeningBook *OpeningBookNew(LookupTable l, ChessBoard start) {
 // Performs a simple BFS over random moves to generate new boards
 void OpeningBookGenerate(OpeningBook *book, int maxDepth) {
     for (int i = 0; i < book->count && maxDepth > 0; i++) {
-        Branch branches[BRANCHES_SIZE];
-        int sz = BranchFill(book->l, &book->boards[i], branches);
-        Move moves[MOVES_SIZE];
-        int movesSize = BranchExtract(branches, sz, moves);
-        for (int m = 0; m < movesSize; m++) {
-            ChessBoard newBoard;
-            ChessBoardPlayMove(&newBoard, &book->boards[i], moves[m]);
+        MoveList moves;
+        BranchLegalMoves(book->l, &book->boards[i], &moves);
+        for (int m = 0; m < moves.size; m++) {
+            // Every new board is kept, so it is copied once and the move played in place
+            Undo undo;
             expandBook(book);
-            memcpy(&book->boards[book->count++], &newBoard, sizeof(ChessBoard));
+            book->boards[book->count] = book->boards[i];
+            ChessBoardMakeMove(&book->boards[book->count++], moves.moves[m], &undo);
         }
         maxDepth--;
     }
@@ -0,0 +1,89 @@
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "See.h"
+
+#define ALL (~cb->pieces[EMPTY_PIECE]) // Bitboard of all the pieces
+#define BOTH(t) (cb->pieces[GET_PIECE(t, White)] | cb->pieces[GET_PIECE(t, Black)])
+
+// Returns a bitboard representing a set of moves given a set of pawns and a color
+#define PAWN_ATTACKS(b, c) ((c == White) ? BitBoardShiftNW(b) | BitBoardShiftNE(b) : BitBoardShiftSW(b) | BitBoardShiftSE(b))
+
+#define MAX_EXCHANGES 32
+
+static const int seeValues[] = {100, 20000, 300, 300, 500, 900}; // Indexed by Type, a king can't be given away
+static const Type seeOrder[] = {Pawn, Knight, Bishop, Rook, Queen, King}; // Least valuable first
+
+static BitBoard attackersTo(LookupTable l, ChessBoard *cb, Square s, BitBoard occupancies);
+
+int SeeEvaluate(LookupTable l, ChessBoard *cb, Move m)
+{
+  BitBoard occupancies = ALL;
+  Square from = MOVE_FROM(m);
+  Square to = MOVE_TO(m);
+  Type moving = GET_TYPE(cb->squares[from]);
+  Piece victim = cb->squares[to];
+  int gain[MAX_EXCHANGES];
+
+  gain[0] = (victim == EMPTY_PIECE) ? 0 : seeValues[GET_TYPE(victim)];
+  if (MOVE_FLAGS(m) == MOVE_EN_PASSANT)
+  { // The captured pawn is not on the destination square
+    gain[0] = seeValues[Pawn];
+    occupancies &= ~BitBoardSetBit(EMPTY_BOARD, to + (cb->turn ? -8 : 8));
+  }
+  int onSquare = seeValues[moving]; // Value of the piece standing on the destination square
+  if (MOVE_IS_PROMOTION(m))
+  {
+    gain[0] += seeValues[MOVE_PROMOTED(m)] - seeValues[Pawn];
+    onSquare = seeValues[MOVE_PROMOTED(m)];
+  }
+
+  occupancies &= ~BitBoardSetBit(EMPTY_BOARD, from);
+  BitBoard attackers = attackersTo(l, cb, to, occupancies) & occupancies;
+  Color side = !cb->turn;
+  int depth = 0;
+  while (depth + 1 < MAX_EXCHANGES)
+  {
+    // The least valuable attacker of the side to recapture
+    BitBoard ours = EMPTY_BOARD;
+    Type t = Pawn;
+    for (int i = 0; i < 6 && ours == EMPTY_BOARD; i++)
+    {
+      t = seeOrder[i];
+      ours = attackers & cb->pieces[GET_PIECE(t, side)];
+    }
+    if (ours == EMPTY_BOARD)
+      break;
+
+    gain[depth + 1] = onSquare - gain[depth];
+    depth++;
+
+    occupancies &= ~BitBoardSetBit(EMPTY_BOARD, BitBoardGetLSB(ours));
+    // Sliders behind the piece which just captured now see the square
+    attackers |= (LookupTableAttacks(l, to, Bishop, occupancies) & (BOTH(Bishop) | BOTH(Queen))) |
+                 (LookupTableAttacks(l, to, Rook, occupancies) & (BOTH(Rook) | BOTH(Queen)));
+    attackers &= occupancies;
+    onSquare = seeValues[t];
+    side = !side;
+  }
+
+  // Each side only recaptures if that is better than stopping
+  while (depth > 0)
+  {
+    gain[depth - 1] = -((-gain[depth - 1] > gain[depth]) ? -gain[depth - 1] : gain[depth]);
+    depth--;
+  }
+  return gain[0];
+}
+
+// Returns the pieces of both colors attacking a square given the occupancies
+static BitBoard attackersTo(LookupTable l, ChessBoard *cb, Square s, BitBoard occupancies)
+{
+  BitBoard b = BitBoardSetBit(EMPTY_BOARD, s);
+  return (PAWN_ATTACKS(b, Black) & cb->pieces[GET_PIECE(Pawn, White)]) |
+         (PAWN_ATTACKS(b, White) & cb->pieces[GET_PIECE(Pawn, Black)]) |
+         (LookupTableAttacks(l, s, Knight, EMPTY_BOARD) & BOTH(Knight)) |
+         (LookupTableAttacks(l, s, King, EMPTY_BOARD) & BOTH(King)) |
+         (LookupTableAttacks(l, s, Bishop, occupancies) & (BOTH(Bishop) | BOTH(Queen))) |
+         (LookupTableAttacks(l, s, Rook, occupancies) & (BOTH(Rook) | BOTH(Queen)));
+}
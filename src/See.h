@@ -0,0 +1,16 @@
+#ifndef SEE_H
+#define SEE_H
+
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+
+/*
+ * Static exchange evaluation: the material, in centipawns, the side to move wins by playing the
+ * move and then letting both sides recapture on its destination square with their least valuable
+ * attacker, each side stopping as soon as recapturing would lose material. Sliders lined up
+ * behind an attacker (x-rays) join in once it has captured. Pins are ignored.
+ */
+int SeeEvaluate(LookupTable l, ChessBoard *cb, Move m);
+
+#endif
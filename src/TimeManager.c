@@ -0,0 +1,110 @@
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "TimeManager.h"
+
+#define DEFAULT_BRANCHING 4.0 // Assumed ratio between two iteration times while only one is known
+#define MIN_BRANCHING 1.5
+#define MAX_BRANCHING 10.0
+#define HARD_LIMIT_FACTOR 4   // The hard limit allows this many times the soft limit
+
+static long nowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+TimeControl TimeControlFixed(int movetime)
+{
+  TimeControl tc = {0};
+  tc.movetime = movetime;
+  return tc;
+}
+
+void TimeManagerStart(TimeManager *tm, TimeControl tc, Color turn)
+{
+  atomic_init(&tm->startNs, nowNs());
+  atomic_init(&tm->pondering, false);
+
+  int time = (turn == White) ? tc.wtime : tc.btime;
+  int inc = (turn == White) ? tc.winc : tc.binc;
+  if (tc.movetime > 0 || time <= 0)
+  {
+    tm->softMs = tc.movetime;
+    tm->hardMs = tc.movetime;
+    return;
+  }
+
+  // Spread the clock over the moves left, the increment is added back after every move
+  long available = time - MOVE_OVERHEAD;
+  if (available < 1)
+    available = 1;
+  int movesToGo = (tc.movestogo > 0) ? tc.movestogo : DEFAULT_MOVES_TO_GO;
+  tm->softMs = available / movesToGo + inc * 3 / 4;
+  tm->hardMs = tm->softMs * HARD_LIMIT_FACTOR;
+
+  // Never plan on more than the clock holds, keeping a little for the next moves
+  if (tm->hardMs > available / 2 + inc)
+    tm->hardMs = available / 2 + inc;
+  if (tm->hardMs > available)
+    tm->hardMs = available;
+  if (tm->softMs > tm->hardMs)
+    tm->softMs = tm->hardMs;
+}
+
+void TimeManagerPonder(TimeManager *tm)
+{
+  atomic_init(&tm->startNs, nowNs());
+  tm->softMs = 0;
+  tm->hardMs = 0;
+  atomic_init(&tm->pondering, true);
+}
+
+void TimeManagerPonderHit(TimeManager *tm, TimeControl tc, Color turn)
+{
+  // The limits are written before pondering is cleared, the search threads read them after
+  TimeManager limits;
+  TimeManagerStart(&limits, tc, turn);
+  atomic_store(&tm->startNs, atomic_load(&limits.startNs));
+  tm->softMs = limits.softMs;
+  tm->hardMs = limits.hardMs;
+  atomic_store_explicit(&tm->pondering, false, memory_order_release);
+}
+
+bool TimeManagerPondering(TimeManager *tm)
+{
+  return atomic_load_explicit(&tm->pondering, memory_order_acquire);
+}
+
+long TimeManagerElapsed(TimeManager *tm)
+{
+  return (nowNs() - atomic_load_explicit(&tm->startNs, memory_order_relaxed)) / 1000000;
+}
+
+bool TimeManagerHardLimit(TimeManager *tm)
+{
+  if (atomic_load_explicit(&tm->pondering, memory_order_acquire))
+    return false;
+  return TimeManagerElapsed(tm) >= tm->hardMs;
+}
+
+bool TimeManagerStartIteration(TimeManager *tm, long lastMs, long previousMs)
+{
+  if (atomic_load_explicit(&tm->pondering, memory_order_acquire))
+    return true;
+  long elapsed = TimeManagerElapsed(tm);
+  if (elapsed >= tm->softMs)
+    return false;
+
+  double branching = DEFAULT_BRANCHING;
+  if (previousMs > 0)
+  {
+    branching = (double)lastMs / previousMs;
+    if (branching < MIN_BRANCHING)
+      branching = MIN_BRANCHING;
+    else if (branching > MAX_BRANCHING)
+      branching = MAX_BRANCHING;
+  }
+  // An iteration which can't finish before the hard limit would only be thrown away
+  return elapsed + lastMs * branching < tm->hardMs;
+}
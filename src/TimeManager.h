@@ -0,0 +1,85 @@
+#ifndef TIMEMANAGER_H
+#define TIMEMANAGER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "BitBoard.h"
+#include "LookupTable.h"
+
+#define TIME_CHECK_NODES 1024 // Nodes searched between two reads of the clock
+#define MOVE_OVERHEAD 30      // Milliseconds kept back on the clock for the move to reach the opponent
+#define DEFAULT_MOVES_TO_GO 30 // Moves the remaining time is split over in sudden death
+
+/*
+ * Time available for a search, as given to a chess engine. All times are in milliseconds,
+ * 0 meaning not given. A fixed move time takes precedence over the clock.
+ */
+typedef struct
+{
+  int wtime;
+  int btime;
+  int winc;
+  int binc;
+  int movestogo;
+  int movetime;
+} TimeControl;
+
+/*
+ * Time budget of a running search. The soft limit is the time the search should take, no
+ * iteration starts past it. The hard limit is never exceeded, the search is aborted there.
+ * While pondering there is no limit until the expected move is played.
+ */
+typedef struct
+{
+  atomic_long startNs; // Wall-clock start of the search (CLOCK_MONOTONIC), moved by a ponder hit
+  long softMs;
+  long hardMs;
+  atomic_bool pondering;
+} TimeManager;
+
+/*
+ * Time control of a search given a fixed time per move
+ */
+TimeControl TimeControlFixed(int movetime);
+
+/*
+ * Starts the clock of a search and sets its limits from the time control of the side to move
+ */
+void TimeManagerStart(TimeManager *tm, TimeControl tc, Color turn);
+
+/*
+ * Starts a search without limits, on the opponent's time
+ */
+void TimeManagerPonder(TimeManager *tm);
+
+/*
+ * The expected move was played: restarts the clock with the limits of the time control, while
+ * the search goes on
+ */
+void TimeManagerPonderHit(TimeManager *tm, TimeControl tc, Color turn);
+
+/*
+ * Returns true until the expected move of a pondering search is played
+ */
+bool TimeManagerPondering(TimeManager *tm);
+
+/*
+ * Milliseconds since the search started
+ */
+long TimeManagerElapsed(TimeManager *tm);
+
+/*
+ * Returns true once the hard limit is reached
+ */
+bool TimeManagerHardLimit(TimeManager *tm);
+
+/*
+ * Returns true if there is time for another iteration. Its duration is predicted from the last
+ * iteration times the effective branching factor, the ratio of the last two iteration times.
+ * previousMs is 0 while only one iteration has completed.
+ */
+bool TimeManagerStartIteration(TimeManager *tm, long lastMs, long previousMs);
+
+#endif
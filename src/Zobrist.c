@@ -3,6 +3,7 @@
 #include "LookupTable.h"
 #include "ChessBoard.h"
 #include "Zobrist.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -18,15 +19,22 @@ uint64_t rand64() {
 
 static const char *ZOBRIST_FILE = "src/data/zobrist.dat";
 
+// White kingside, white queenside, black kingside, black queenside
+static const Square CASTLING_KINGS[4] = {60, 60, 4, 4};
+static const Square CASTLING_ROOKS[4] = {63, 56, 7, 0};
+
+Zobrist_Table zobrist_keys;
+static pthread_once_t zobristKeysOnce = PTHREAD_ONCE_INIT;
+
 
 void free_zobrist(Zobrist_Table *table);
 void load_zobrist(Zobrist_Table *table);
 void save_zobrist(Zobrist_Table *table);
 
-Zobrist_Table *init_zobrist()
+// Fills the shared keys from the Zobrist file, creating the file on first use
+static void load_zobrist_keys(void)
 {
-    Zobrist_Table *table = malloc(sizeof(Zobrist_Table));
-
+    Zobrist_Table *table = &zobrist_keys;
 
     if (zobrist_file_exists()) {
         load_zobrist(table);
@@ -49,6 +57,18 @@ Zobrist_Table *init_zobrist()
         
         save_zobrist(table);
     }
+}
+
+void init_zobrist_keys()
+{
+    pthread_once(&zobristKeysOnce, load_zobrist_keys);
+}
+
+Zobrist_Table *init_zobrist()
+{
+    init_zobrist_keys();
+    Zobrist_Table *table = malloc(sizeof(Zobrist_Table));
+    *table = zobrist_keys;
     return table;
 }
 
@@ -124,23 +144,34 @@ uint64_t get_zobrist_hash(ChessBoard *cb, Zobrist_Table *table)
     uint64_t hash = 0;
     for (int i = 0; i < BOARD_SIZE; i++)
     {
-        hash ^= table->piece_pos_values[i][cb->squares[i]];
+        if (cb->squares[i] != EMPTY_PIECE)
+        {
+            hash ^= table->piece_pos_values[i][cb->squares[i]];
+        }
     }
     if (cb->enPassant != EMPTY_SQUARE)
     {
         hash ^= table->en_passant_values[cb->enPassant];
     }
+    hash ^= zobrist_castling(table, cb->castling);
+    if (cb->turn == Black)
+    {
+        hash ^= table->black_to_move_value;
+    }
+    return hash;
+}
+
+uint64_t zobrist_castling(Zobrist_Table *table, BitBoard castling)
+{
+    uint64_t hash = 0;
     for (int i = 0; i < 4; i++)
     {
-        if (cb->castling & (1 << i))
+        // A side may castle while both its king and that rook are still on their original squares
+        BitBoard kingAndRook = BitBoardSetBit(EMPTY_BOARD, CASTLING_KINGS[i]) | BitBoardSetBit(EMPTY_BOARD, CASTLING_ROOKS[i]);
+        if ((castling & kingAndRook) == kingAndRook)
         {
             hash ^= table->castling_values[i];
         }
     }
-    if (cb->turn == Black)
-    {
-        hash ^= table->black_to_move_value;
-    }
     return hash;
 }
-
@@ -12,6 +12,19 @@ typedef struct
     uint64_t black_to_move_value;
 } Zobrist_Table;
 
+/*
+ * Keys used by every board to keep its hash up to date, filled by init_zobrist_keys
+ */
+extern Zobrist_Table zobrist_keys;
+
+/*
+ * Loads the shared keys from the Zobrist file once, creating the file if it does not exist
+ */
+void init_zobrist_keys();
+
+/*
+ * Returns a copy of the shared keys, to be freed with free_zobrist
+ */
 Zobrist_Table *init_zobrist();
 
 int zobrist_file_exists();
@@ -22,5 +35,13 @@ void save_zobrist(Zobrist_Table *table);
 
 void free_zobrist(Zobrist_Table *table);
 
+/*
+ * Computes the hash of a board from scratch, boards carry it in their hash field
+ */
 uint64_t get_zobrist_hash(ChessBoard *cb, Zobrist_Table *table);
+
+/*
+ * Returns the part of a hash given by a set of castling squares
+ */
+uint64_t zobrist_castling(Zobrist_Table *table, BitBoard castling);
 #endif
\ No newline at end of file
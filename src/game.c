@@ -7,14 +7,15 @@
 #include "Branch.h"
 #include "Minimax.h"
 #include "ChessBoardHelper.h"
+#include "Console.h"
 
 
 
-#include <signal.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define TIME_LIMIT 8000 // in milliseconds
 
@@ -24,25 +25,28 @@ static int checkGameOver(ChessBoard *cb, LookupTable l);
 
 static int legalMove(char *moveStr, ChessBoard *cb, LookupTable l);
 
-void clean_lookups(int sig);
+static void stopPondering(void);
+
+static void clean_lookups(void);
 
 ChessBoard *cb;
 LookupTable l;
 Dictionary dict;
+int threads;
+int hashMb;
+static GameHistory gameHistory; // Moves of the game, for the move list and repetitions
+static PonderSearch *activePonder = NULL; // Search of the expected reply while the player thinks, stopped before the dictionary is freed
 
-int main(int argc  __attribute__((unused)), char **argv __attribute__((unused)))
+int main(int argc, char **argv)
 {
-    struct sigaction sa;
-    sa.sa_handler = clean_lookups;
-    sa.sa_flags = 0;
-    sigemptyset(&sa.sa_mask);
-    sigaction(SIGINT, &sa, NULL);  // Handle Ctrl+C
-    sigaction(SIGTERM, &sa, NULL); // Handle termination
-    sigaction(SIGQUIT, &sa, NULL); // Handle quit
-    sigaction(SIGTSTP, &sa, NULL); // Handle Ctrl+Z
+    threads = parseOption(argc, argv, "--threads", 1);
+    hashMb = parseOption(argc, argv, "--hash", DEFAULT_HASH_MB);
+
+    catchInterrupts(); // Searches wind down before the dictionary they share is saved and freed
 
 
     ChessBoard cb = ChessBoardNew("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 2); //  
+    init_dictionary(&dict, hashMb); // Shared by all search threads
     runGame(&cb);   
 }
 
@@ -50,15 +54,21 @@ int main(int argc  __attribute__((unused)), char **argv __attribute__((unused)))
 static void runGame(ChessBoard *cbinit)
 {
     cb = cbinit;
+    cb->history = &gameHistory;
     l = LookupTableNew();
 
     ChessBoard *new = malloc(sizeof(ChessBoard));
+    SearchLimits limits = {.tc = TimeControlFixed(TIME_LIMIT), .minDepth = 2, .depth_speed = 2, .threads = threads, .verbose = true};
 
 
     if (cb->turn == Black){
         cb->depth = 2;
-        Move aiMove = bestMove(l, cb, &dict, -1, TIME_LIMIT, 2, true);
-        
+        SearchLimits first = limits;
+        first.minDepth = -1;
+        Move aiMove = think(SearchStart(l, cb, &dict, first), NULL, false);
+        if (interrupted) {
+            clean_lookups();
+        }
         
         printf("AI move: %s\n", moveToString(aiMove));
         ChessBoardPlayMove(new, cb, aiMove);
@@ -74,31 +84,41 @@ static void runGame(ChessBoard *cbinit)
             ChessBoardPrintBoard(*cb); // Print the board
             printf("Stalemate!\n");
             LookupTableFree(l);
+        } else if (gameState >= 3) {
+            ChessBoardPrintBoard(*cb); // Print the board
+            printf(gameState == 3 ? "Draw by threefold repetition!\n" : "Draw by the fifty-move rule!\n");
+            LookupTableFree(l);
         }
     }
     
-    while (1)
+    PonderSearch ponder;
+    while (!interrupted)
     {   
         
         ChessBoardPrintBoard(*cb); // Print the board
+
+        // Search the expected reply while the player thinks
+        cb->depth = 2;
+        activePonder = ponderStart(&ponder, l, cb, &dict, 2, 2, threads, limits.verbose) ? &ponder : NULL;
         char moveStr[5] = {0};
         printf("Enter a move: ");
-        if (scanf("%4s", moveStr) != 1) {
-            fprintf(stderr, "Error reading input\n");
-            return;
-        }
-        while(legalMove(moveStr, cb, l)==0){
-            if(moveStr=="exit"){
+        bool inputFailed = scanf("%4s", moveStr) != 1;
+        while(!inputFailed && legalMove(moveStr, cb, l)==0){
+            if(strcmp(moveStr, "exit") == 0){
                 break;
             }
             printf("Invalid move. Enter a move (4 characters): ");
-            if (scanf("%4s", moveStr) != 1) {
+            inputFailed = scanf("%4s", moveStr) != 1;
+        }
+        if (inputFailed || strcmp(moveStr, "exit") == 0) {
+            stopPondering();
+            if (interrupted) {
+                break; // The read was cut short by the signal
+            } else if (inputFailed) {
                 fprintf(stderr, "Error reading input\n");
-                return;
+            } else {
+                ChessBoardPrintMovelist(*cb);
             }
-        }
-        if (strcmp(moveStr, "exit") == 0) {
-            ChessBoardPrintMovelist(*cb);
             break;
         }
 
@@ -108,22 +128,44 @@ static void runGame(ChessBoard *cbinit)
         ChessBoardPlayMove(new, cb, playerMove);
         memcpy(cb, new, sizeof(ChessBoard));
         printf("Player move: %s\n", moveStr);
+
+        // The search goes on if the player made the expected move, otherwise only the dictionary it filled is kept
+        if (activePonder != NULL && cb->hash != ponder.board.hash) {
+            stopPondering();
+        }
         ChessBoardPrintBoard(*cb); // Print the board
         int gameState= checkGameOver(cb, l);
         printf("Game state: %d\n", gameState);
+        if (gameState != 0) {
+            stopPondering();
+        }
         if (gameState == 1) {
             printf("You win!\n");
             break;
         } else if (gameState == 2) {
             printf("Stalemate!\n");
             break;
+        } else if (gameState >= 3) {
+            printf(gameState == 3 ? "Draw by threefold repetition!\n" : "Draw by the fifty-move rule!\n");
+            break;
         }
 
         
         
         
-        cb->depth = 2;
-        Move aiMove = bestMove(l, cb, &dict, 2, TIME_LIMIT, 2, true);
+        Move aiMove;
+        if (activePonder != NULL) {
+            printf("Ponder hit\n");
+            Search *search = ponderHit(activePonder, TimeControlFixed(TIME_LIMIT));
+            activePonder = NULL; // think waits for the search to end
+            aiMove = think(search, NULL, false);
+        } else {
+            cb->depth = 2;
+            aiMove = think(SearchStart(l, cb, &dict, limits), NULL, false);
+        }
+        if (interrupted) {
+            break;
+        }
         
         
         printf("AI move: %s\n", moveToString(aiMove));
@@ -139,21 +181,23 @@ static void runGame(ChessBoard *cbinit)
             ChessBoardPrintBoard(*cb); // Print the board
             printf("Stalemate!\n");
             break;
+        } else if (gameState >= 3) {
+            ChessBoardPrintBoard(*cb); // Print the board
+            printf(gameState == 3 ? "Draw by threefold repetition!\n" : "Draw by the fifty-move rule!\n");
+            break;
         }
         
 
     }
     
-    clean_lookups(0);
+    clean_lookups();
     
 }
 
 
 int checkGameOver(ChessBoard *cb, LookupTable l){
-  Branch branches[BRANCHES_SIZE];
-  int branchesSize = BranchFill(l, cb, branches);
-  Move moves[MOVES_SIZE];
-  int movesSize = BranchExtract(branches, branchesSize, moves);
+  MoveList moves;
+  int movesSize = BranchLegalMoves(l, cb, &moves);
 
   if(movesSize == 0){
     BitBoard checking = ChessBoardChecking(l, cb);
@@ -162,6 +206,10 @@ int checkGameOver(ChessBoard *cb, LookupTable l){
     } else {
       return 2;
     }
+  } else if (ChessBoardRepetitions(cb) >= 2){
+    return 3;
+  } else if (cb->halfmove_clock >= FIFTY_MOVE_PLIES){
+    return 4;
   } else{
     return 0;
   }
@@ -176,19 +224,26 @@ int legalMove(char *moveStr, ChessBoard *cb, LookupTable l){
     }
     Move move = parseMove(moveStr, cb);
 
-    Branch branches[BRANCHES_SIZE];
-    int branchesSize = BranchFill(l, cb, branches);
-    Move moves[MOVES_SIZE];
-    int movesSize = BranchExtract(branches, branchesSize, moves);
-    for (int i = 0; i < movesSize; i++) {
-        if (moves[i].from == move.from && moves[i].to == move.to) {
+    MoveList moves;
+    BranchLegalMoves(l, cb, &moves);
+    for (int i = 0; i < moves.size; i++) {
+        if (moves.moves[i] == move) {
             return 1;
         }
     }
     return 0;
 }
 
-void clean_lookups(int sig) {
+static void stopPondering(void) {
+    if (activePonder != NULL) {
+        ponderStop(activePonder);
+        activePonder = NULL;
+    }
+}
+
+// Saves and frees the shared tables once no search uses them any more, then ends the program
+static void clean_lookups(void) {
+    stopPondering();
     printf("\nGame over\n");
     
     if(dict.zobrist != NULL){
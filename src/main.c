@@ -7,45 +7,74 @@
 #include "Branch.h"
 #include "Minimax.h"
 #include "ChessBoardHelper.h"
+#include "Console.h"
 
-#include <signal.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define TIME_LIMIT 10000 // in milliseconds
 
 static void runGame(ChessBoard *cbinit);
-static void runApi(char *fen);
+static void runApi(char *fen, TimeControl tc, bool stats, int multiPv);
+static void runBench(int maxThreads, int depth);
 static int checkGameOver(ChessBoard *cb, LookupTable l);
 static int legalMove(char *moveStr, ChessBoard *cb, LookupTable l);
-void clean_lookups(int sig);
+static void stopPondering(void);
+static void clean_lookups(void);
 
 ChessBoard *cb;
 LookupTable l;
 Dictionary dict;
+int threads;
+int hashMb;
+static GameHistory gameHistory; // Moves of the game, for the move list and repetitions
+static PonderSearch *activePonder = NULL; // Search of the expected reply while the player thinks, stopped before the dictionary is freed
 
 int main(int argc, char *argv[]) {
-    struct sigaction sa;
-    sa.sa_handler = clean_lookups;
-    sa.sa_flags = 0;
-    sigemptyset(&sa.sa_mask);
-    sigaction(SIGINT, &sa, NULL);
-    sigaction(SIGTERM, &sa, NULL);
-    sigaction(SIGQUIT, &sa, NULL);
-    sigaction(SIGTSTP, &sa, NULL);
+    threads = parseOption(argc, argv, "--threads", 1);
+    hashMb = parseOption(argc, argv, "--hash", DEFAULT_HASH_MB);
+    catchInterrupts(); // Searches wind down before the dictionary they share is saved and freed
 
     if (argc > 1) {
         if (strcmp(argv[1], "--train") == 0) {
             //train_main(); // Call your training function
         } else if (strcmp(argv[1], "--api") == 0) {
             if (argc > 2) {
-                runApi(argv[2]); // Call api function with fen string.
+                // Clock in milliseconds as sent by a GUI, a fixed TIME_LIMIT per move if none is given
+                TimeControl tc = {0};
+                tc.wtime = parseOption(argc, argv, "--wtime", 0);
+                tc.btime = parseOption(argc, argv, "--btime", 0);
+                tc.winc = parseOption(argc, argv, "--winc", 0);
+                tc.binc = parseOption(argc, argv, "--binc", 0);
+                tc.movestogo = parseOption(argc, argv, "--movestogo", 0);
+                tc.movetime = parseOption(argc, argv, "--movetime", 0);
+                if (tc.wtime == 0 && tc.btime == 0 && tc.movetime == 0) {
+                    tc.movetime = TIME_LIMIT;
+                }
+                bool stats = false;
+                for (int i = 3; i < argc; i++) {
+                    if (strcmp(argv[i], "--stats") == 0) {
+                        stats = true;
+                    }
+                }
+                runApi(argv[2], tc, stats, parseOption(argc, argv, "--multipv", 1)); // Call api function with fen string.
             } else {
-                fprintf(stderr, "Usage: %s --api <fen>\n", argv[0]);
+                fprintf(stderr, "Usage: %s --api <fen> [--threads N] [--hash MB] [--wtime MS --btime MS [--winc MS --binc MS] [--movestogo N] | --movetime MS] [--stats] [--multipv K]\n", argv[0]);
                 return 1;
             }
+        } else if (strcmp(argv[1], "--bench") == 0) {
+            if (argc > 2) {
+                runBench(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 4);
+            } else {
+                fprintf(stderr, "Usage: %s --bench <max threads> [depth]\n", argv[0]);
+                return 1;
+            }
+        } else {
+            ChessBoard cb = ChessBoardNew("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 2);
+            runGame(&cb);
         }
     } else {
         ChessBoard cb = ChessBoardNew("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 2);
@@ -55,22 +84,43 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-static void runApi(char *fen) {
+static void runApi(char *fen, TimeControl tc, bool stats, int multiPv) {
     l = LookupTableNew();
+    init_dictionary(&dict, hashMb); // Shared by all search threads, loaded from the trained dictionary
     ChessBoard cb = ChessBoardNew(fen, 2);
-    Move aiMove = bestMove(l, &cb, &dict, 2, TIME_LIMIT, 2, false);
+    SearchLimits limits = {.tc = tc, .minDepth = 2, .depth_speed = 2, .threads = threads, .verbose = false, .stats = stats, .multiPv = multiPv};
+    setvbuf(stdin, NULL, _IONBF, 0); // think polls the descriptor, so no line may wait in a stdio buffer
+    Move aiMove = think(SearchStart(l, &cb, &dict, limits), stderr, true); // Only the move goes to stdout
     printf("%s\n", moveToString(aiMove));
+    free_dictionary(&dict);
+    LookupTableFree(l);
+}
+
+// Reports time-to-depth and NPS for 1..maxThreads threads on the perft test positions
+static void runBench(int maxThreads, int depth) {
+    l = LookupTableNew();
+    init_dictionary(&dict, hashMb);
+    benchmarkThreads(l, &dict, "src/data/testPositions.in", depth, maxThreads);
+    free_dictionary(&dict);
     LookupTableFree(l);
 }
 
 static void runGame(ChessBoard *cbinit) {
     cb = cbinit;
+    cb->history = &gameHistory;
     l = LookupTableNew();
+    init_dictionary(&dict, hashMb); // Shared by all search threads
     ChessBoard *new = malloc(sizeof(ChessBoard));
+    SearchLimits limits = {.tc = TimeControlFixed(TIME_LIMIT), .minDepth = 2, .depth_speed = 2, .threads = threads, .verbose = true};
 
     if (cb->turn == Black) {
         cb->depth = 2;
-        Move aiMove = bestMove(l, cb, &dict, -1, TIME_LIMIT, 2, true);
+        SearchLimits first = limits;
+        first.minDepth = -1;
+        Move aiMove = think(SearchStart(l, cb, &dict, first), NULL, false);
+        if (interrupted) {
+            clean_lookups();
+        }
         printf("AI move: %s\n", moveToString(aiMove));
         ChessBoardPlayMove(new, cb, aiMove);
         memcpy(cb, new, sizeof(ChessBoard));
@@ -86,29 +136,40 @@ static void runGame(ChessBoard *cbinit) {
             printf("Stalemate!\n");
             LookupTableFree(l);
             return;
+        } else if (gameState >= 3) {
+            ChessBoardPrintBoard(*cb);
+            printf(gameState == 3 ? "Draw by threefold repetition!\n" : "Draw by the fifty-move rule!\n");
+            LookupTableFree(l);
+            return;
         }
     }
 
-    while (1) {
+    PonderSearch ponder;
+    while (!interrupted) {
         ChessBoardPrintBoard(*cb);
+
+        // Search the expected reply while the player thinks
+        cb->depth = 2;
+        activePonder = ponderStart(&ponder, l, cb, &dict, 2, 2, threads, limits.verbose) ? &ponder : NULL;
         char moveStr[5] = {0};
         printf("Enter a move: ");
-        if (scanf("%4s", moveStr) != 1) {
-            fprintf(stderr, "Error reading input\n");
-            break;
-        }
-        while (legalMove(moveStr, cb, l) == 0) {
+        bool inputFailed = scanf("%4s", moveStr) != 1;
+        while (!inputFailed && legalMove(moveStr, cb, l) == 0) {
             if (strcmp(moveStr, "exit") == 0) {
                 break;
             }
             printf("Invalid move. Enter a move (4 characters): ");
-            if (scanf("%4s", moveStr) != 1) {
+            inputFailed = scanf("%4s", moveStr) != 1;
+        }
+        if (inputFailed || strcmp(moveStr, "exit") == 0) {
+            stopPondering();
+            if (interrupted) {
+                break; // The read was cut short by the signal
+            } else if (inputFailed) {
                 fprintf(stderr, "Error reading input\n");
-                break;
+            } else {
+                ChessBoardPrintMovelist(*cb);
             }
-        }
-        if (strcmp(moveStr, "exit") == 0) {
-            ChessBoardPrintMovelist(*cb);
             break;
         }
 
@@ -116,19 +177,41 @@ static void runGame(ChessBoard *cbinit) {
         ChessBoardPlayMove(new, cb, playerMove);
         memcpy(cb, new, sizeof(ChessBoard));
         printf("Player move: %s\n", moveStr);
+
+        // The search goes on if the player made the expected move, otherwise only the dictionary it filled is kept
+        if (activePonder != NULL && cb->hash != ponder.board.hash) {
+            stopPondering();
+        }
         ChessBoardPrintBoard(*cb);
         int gameState = checkGameOver(cb, l);
         printf("Game state: %d\n", gameState);
+        if (gameState != 0) {
+            stopPondering();
+        }
         if (gameState == 1) {
             printf("You win!\n");
             break;
         } else if (gameState == 2) {
             printf("Stalemate!\n");
             break;
+        } else if (gameState >= 3) {
+            printf(gameState == 3 ? "Draw by threefold repetition!\n" : "Draw by the fifty-move rule!\n");
+            break;
         }
 
-        cb->depth = 2;
-        Move aiMove = bestMove(l, cb, &dict, 2, TIME_LIMIT, 2, true);
+        Move aiMove;
+        if (activePonder != NULL) {
+            printf("Ponder hit\n");
+            Search *search = ponderHit(activePonder, TimeControlFixed(TIME_LIMIT));
+            activePonder = NULL; // think waits for the search to end
+            aiMove = think(search, NULL, false);
+        } else {
+            cb->depth = 2;
+            aiMove = think(SearchStart(l, cb, &dict, limits), NULL, false);
+        }
+        if (interrupted) {
+            break;
+        }
         printf("AI move: %s\n", moveToString(aiMove));
         ChessBoardPlayMove(new, cb, aiMove);
         memcpy(cb, new, sizeof(ChessBoard));
@@ -142,17 +225,19 @@ static void runGame(ChessBoard *cbinit) {
             ChessBoardPrintBoard(*cb);
             printf("Stalemate!\n");
             break;
+        } else if (gameState >= 3) {
+            ChessBoardPrintBoard(*cb);
+            printf(gameState == 3 ? "Draw by threefold repetition!\n" : "Draw by the fifty-move rule!\n");
+            break;
         }
     }
 
-    clean_lookups(0);
+    clean_lookups();
 }
 
 int checkGameOver(ChessBoard *cb, LookupTable l) {
-    Branch branches[BRANCHES_SIZE];
-    int branchesSize = BranchFill(l, cb, branches);
-    Move moves[MOVES_SIZE];
-    int movesSize = BranchExtract(branches, branchesSize, moves);
+    MoveList moves;
+    int movesSize = BranchLegalMoves(l, cb, &moves);
 
     if (movesSize == 0) {
         BitBoard checking = ChessBoardChecking(l, cb);
@@ -161,6 +246,10 @@ int checkGameOver(ChessBoard *cb, LookupTable l) {
         } else {
             return 2;
         }
+    } else if (ChessBoardRepetitions(cb) >= 2) {
+        return 3;
+    } else if (cb->halfmove_clock >= FIFTY_MOVE_PLIES) {
+        return 4;
     } else {
         return 0;
     }
@@ -175,19 +264,26 @@ int legalMove(char *moveStr, ChessBoard *cb, LookupTable l) {
     }
     Move move = parseMove(moveStr, cb);
 
-    Branch branches[BRANCHES_SIZE];
-    int branchesSize = BranchFill(l, cb, branches);
-    Move moves[MOVES_SIZE];
-    int movesSize = BranchExtract(branches, branchesSize, moves);
-    for (int i = 0; i < movesSize; i++) {
-        if (moves[i].from == move.from && moves[i].to == move.to) {
+    MoveList moves;
+    BranchLegalMoves(l, cb, &moves);
+    for (int i = 0; i < moves.size; i++) {
+        if (moves.moves[i] == move) {
             return 1;
         }
     }
     return 0;
 }
 
-void clean_lookups(int sig) {
+static void stopPondering(void) {
+    if (activePonder != NULL) {
+        ponderStop(activePonder);
+        activePonder = NULL;
+    }
+}
+
+// Saves and frees the shared tables once no search uses them any more, then ends the program
+static void clean_lookups(void) {
+    stopPondering();
     printf("\nGame over\n");
     if (dict.zobrist != NULL) {
         exit_dictionary(&dict);
@@ -0,0 +1,337 @@
+#define _XOPEN_SOURCE 700
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "Branch.h"
+#include "ChessBoardHelper.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_POSITIONS_FILE "src/data/testPositions.in"
+#define TEST_PASSED "✓ PASSED: "
+#define TEST_FAILED "✗ FAILED: "
+#define MAX_THREADS 64
+#define MODES_DEPTH 3 // Depth to which the generation modes are checked against BranchFill
+
+/*
+ * Subtree sizes of positions already counted, keyed by the board's hash. As in the dictionary,
+ * check holds key ^ data so an entry torn by two threads writing at once never matches.
+ * data packs nodes << 8 | depth.
+ */
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} PerftEntry;
+
+typedef struct {
+    PerftEntry *entries;
+    uint64_t size; // Always a power of two, 0 if the table is disabled
+} PerftTable;
+
+// Root moves are handed out one at a time to the threads, each on its own copy of the board
+typedef struct {
+    LookupTable l;
+    ChessBoard board;
+    PerftTable *table;
+    Move *moves;
+    uint64_t *counts;
+    int movesSize;
+    int depth;
+    atomic_int *next;
+} PerftWorker;
+
+static int runFile(LookupTable l, PerftTable *table, int threads, int maxDepth, bool divide);
+static uint64_t perftRoot(LookupTable l, ChessBoard *cb, int depth, PerftTable *table, int threads, bool divide);
+static uint64_t perft(LookupTable l, ChessBoard *cb, int depth, PerftTable *table);
+static int checkModes(LookupTable l, ChessBoard *cb, int depth);
+static int checkSubset(Branch *all, int allSize, Branch *part, int partSize);
+static void *perftWorker(void *arg);
+static long elapsedMs(struct timespec *start);
+static char *parseString(int argc, char **argv, const char *name, char *fallback);
+
+/*
+ * Usage: perft [--threads N] [--hash MB] [--depth D] [--divide] [--fen "<fen>"]
+ *
+ * Without --fen every position of src/data/testPositions.in is counted to its depth and checked
+ * against its expected node count, --depth lowering the depth of the deeper ones (unchecked).
+ * With --fen the position is counted to --depth with divide output.
+ * Every position of the file also has its captures, quiets and evasions checked against its full
+ * move list at every node to MODES_DEPTH.
+ */
+int main(int argc, char *argv[]) {
+    int threads = parseOption(argc, argv, "--threads", 1);
+    int hashMb = parseOption(argc, argv, "--hash", 0);
+    int depth = parseOption(argc, argv, "--depth", 0);
+    char *fen = parseString(argc, argv, "--fen", NULL);
+    bool divide = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--divide") == 0) {
+            divide = true;
+        }
+    }
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    LookupTable l = LookupTableNew();
+    PerftTable table = {0};
+    if (hashMb > 0) {
+        table.size = 1;
+        while (table.size * 2 * sizeof(PerftEntry) <= (uint64_t)hashMb << 20) {
+            table.size *= 2;
+        }
+        table.entries = calloc(table.size, sizeof(PerftEntry));
+    }
+
+#ifdef PSEUDO_LEGAL
+    printf("Move generation: pseudo-legal\n");
+#else
+    printf("Move generation: legal\n");
+#endif
+    int failed = 0;
+    if (fen != NULL) {
+        ChessBoard cb = ChessBoardNew(fen, 0);
+        perftRoot(l, &cb, depth > 0 ? depth : 1, &table, threads, true);
+    } else {
+        failed = runFile(l, &table, threads, depth, divide);
+    }
+
+    if (table.entries != NULL) {
+        free(table.entries);
+    }
+    LookupTableFree(l);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Each line of the file is a FEN without move counters, followed by a depth and a node count
+static int runFile(LookupTable l, PerftTable *table, int threads, int maxDepth, bool divide) {
+    FILE *file = fopen(TEST_POSITIONS_FILE, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s\n", TEST_POSITIONS_FILE);
+        return 1;
+    }
+
+    int failed = 0;
+    uint64_t totalNodes = 0;
+    long totalMs = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = 0;
+        char *expectedStr = strrchr(line, ' ');
+        if (expectedStr == NULL) {
+            continue;
+        }
+        *expectedStr = 0;
+        char *depthStr = strrchr(line, ' ');
+        if (depthStr == NULL) {
+            continue;
+        }
+        *depthStr = 0;
+        int depth = atoi(depthStr + 1);
+        uint64_t expected = strtoull(expectedStr + 1, NULL, 10);
+        bool checked = maxDepth <= 0 || depth <= maxDepth;
+        if (!checked) {
+            depth = maxDepth;
+        }
+
+        printf("Position: %s\n", line);
+        ChessBoard cb = ChessBoardNew(line, 0);
+        struct timespec startTime;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        uint64_t nodes = perftRoot(l, &cb, depth, table, threads, divide);
+        long ms = elapsedMs(&startTime);
+        totalNodes += nodes;
+        totalMs += ms;
+
+        printf("Depth: %d  Nodes: %12llu  Time: %7ld ms  NPS: %10llu  ", depth, (unsigned long long)nodes, ms,
+               (unsigned long long)(ms > 0 ? nodes * 1000 / ms : nodes));
+        if (!checked) {
+            printf("(not checked)\n");
+        } else if (nodes == expected) {
+            printf("%sperft(%d)\n", TEST_PASSED, depth);
+        } else {
+            printf("%sperft(%d) expected %llu\n", TEST_FAILED, depth, (unsigned long long)expected);
+            failed++;
+        }
+
+        int modesDepth = depth < MODES_DEPTH ? depth : MODES_DEPTH;
+        int mismatches = checkModes(l, &cb, modesDepth);
+        if (mismatches == 0) {
+            printf("%sgeneration modes(%d)\n", TEST_PASSED, modesDepth);
+        } else {
+            printf("%sgeneration modes(%d) - %d nodes differ\n", TEST_FAILED, modesDepth, mismatches);
+            failed++;
+        }
+    }
+    fclose(file);
+
+    printf("Total nodes: %llu  Time: %ld ms  NPS: %llu\n", (unsigned long long)totalNodes, totalMs,
+           (unsigned long long)(totalMs > 0 ? totalNodes * 1000 / totalMs : totalNodes));
+    return failed;
+}
+
+// Splits the root moves across the threads, printing the subtree size of every root move if asked
+static uint64_t perftRoot(LookupTable l, ChessBoard *cb, int depth, PerftTable *table, int threads, bool divide) {
+    Branch branches[BRANCHES_SIZE];
+    int branchesSize = BranchFill(l, cb, branches);
+    Move moves[MOVES_SIZE];
+    int movesSize = BranchFilterLegal(l, cb, moves, BranchExtract(branches, branchesSize, moves));
+    uint64_t counts[MOVES_SIZE];
+
+    atomic_int next = 0;
+    PerftWorker workers[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (PerftWorker){l, *cb, table, moves, counts, movesSize, depth, &next};
+        if (i > 0) {
+            pthread_create(&ids[i], NULL, perftWorker, &workers[i]);
+        }
+    }
+    perftWorker(&workers[0]);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < movesSize; i++) {
+        nodes += counts[i];
+        if (divide) {
+            printf("%s: %llu\n", moveToString(moves[i]), (unsigned long long)counts[i]);
+        }
+    }
+    if (divide) {
+        printf("Moves: %d  Nodes: %llu\n", movesSize, (unsigned long long)nodes);
+    }
+    return nodes;
+}
+
+static void *perftWorker(void *arg) {
+    PerftWorker *worker = arg;
+    int i;
+    while ((i = atomic_fetch_add(worker->next, 1)) < worker->movesSize) {
+        Undo undo;
+        ChessBoardMakeMove(&worker->board, worker->moves[i], &undo);
+        worker->counts[i] = perft(worker->l, &worker->board, worker->depth - 1, worker->table);
+        ChessBoardUnmakeMove(&worker->board, &undo);
+    }
+    return NULL;
+}
+
+/*
+ * Counts the leaves of the legal move tree, the last ply is counted in bulk from the branches.
+ * Built with PSEUDO_LEGAL every move is played and checked instead, down to the leaves.
+ */
+static uint64_t perft(LookupTable l, ChessBoard *cb, int depth, PerftTable *table) {
+    if (depth == 0) {
+        return 1;
+    }
+
+    uint64_t key = 0;
+    PerftEntry *entry = NULL;
+    if (table->size > 0 && depth > 1) {
+        key = cb->hash;
+        entry = &table->entries[key & (table->size - 1)];
+        uint64_t data = entry->data;
+        if ((entry->check ^ data) == key && (int)(data & 0xFF) == depth) {
+            return data >> 8;
+        }
+    }
+
+    Branch branches[BRANCHES_SIZE];
+    int branchesSize = BranchFill(l, cb, branches);
+#ifndef PSEUDO_LEGAL
+    if (depth == 1) {
+        return BranchCount(branches, branchesSize);
+    }
+#endif
+
+    Move moves[MOVES_SIZE];
+    int movesSize = BranchExtract(branches, branchesSize, moves);
+    uint64_t nodes = 0;
+    for (int i = 0; i < movesSize; i++) {
+        Undo undo;
+        ChessBoardMakeMove(cb, moves[i], &undo);
+        if (LEGAL_AFTER_MOVE(l, cb)) {
+            nodes += perft(l, cb, depth - 1, table);
+        }
+        ChessBoardUnmakeMove(cb, &undo);
+    }
+
+    if (entry != NULL) {
+        uint64_t data = nodes << 8 | (uint64_t)depth;
+        entry->check = key ^ data;
+        entry->data = data;
+    }
+    return nodes;
+}
+
+/*
+ * Counts the nodes where the captures and the quiets don't split the legal moves in two, or where
+ * the evasions don't give all the legal moves
+ */
+static int checkModes(LookupTable l, ChessBoard *cb, int depth) {
+    Branch all[BRANCHES_SIZE], captures[BRANCHES_SIZE], quiets[BRANCHES_SIZE], evasions[BRANCHES_SIZE];
+    int allSize = BranchFill(l, cb, all);
+    int capturesSize = BranchFillCaptures(l, cb, captures);
+    int quietsSize = BranchFillQuiets(l, cb, quiets);
+    int evasionsSize = BranchFillEvasions(l, cb, evasions);
+
+    // Pseudo-legal evasions leave out moves which are not legal anyway, so only the legal ones are compared
+    Move moves[MOVES_SIZE], evasionMoves[MOVES_SIZE];
+    int movesSize = BranchFilterLegal(l, cb, moves, BranchExtract(all, allSize, moves));
+    int evasionMovesSize = BranchFilterLegal(l, cb, evasionMoves, BranchExtract(evasions, evasionsSize, evasionMoves));
+
+    int count = BranchCount(all, allSize);
+    int mismatches = BranchCount(captures, capturesSize) + BranchCount(quiets, quietsSize) != count ||
+                     evasionMovesSize != movesSize ||
+                     !checkSubset(all, allSize, captures, capturesSize) ||
+                     !checkSubset(all, allSize, quiets, quietsSize) ||
+                     !checkSubset(all, allSize, evasions, evasionsSize);
+    if (depth <= 1) {
+        return mismatches;
+    }
+
+    for (int i = 0; i < movesSize; i++) {
+        Undo undo;
+        ChessBoardMakeMove(cb, moves[i], &undo);
+        mismatches += checkModes(l, cb, depth - 1);
+        ChessBoardUnmakeMove(cb, &undo);
+    }
+    return mismatches;
+}
+
+// True if every move of part is a legal move of all
+static int checkSubset(Branch *all, int allSize, Branch *part, int partSize) {
+    Move moves[MOVES_SIZE];
+    int movesSize = BranchExtract(part, partSize, moves);
+    for (int i = 0; i < movesSize; i++) {
+        if (!BranchContains(all, allSize, moves[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static long elapsedMs(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static char *parseString(int argc, char **argv, const char *name, char *fallback){
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return argv[i + 1];
+        }
+    }
+    return fallback;
+}
@@ -29,6 +29,17 @@ void verify_dictionary_entry(Dictionary *dict, ChessBoard *cb, int expectedScore
     }
 }
 
+// Lookups return a per-thread snapshot, so each entry is checked before the next lookup
+void verify_key_entry(Dictionary *dict, uint64_t key, int expectedScore, int expectedDepth, const char *testName) {
+    nlist *entry = lookup(dict, key);
+
+    if (entry && entry->score == expectedScore && entry->depth == expectedDepth) {
+        printf("%s%s\n", TEST_PASSED, testName);
+    } else {
+        printf("%s%s - not found or incorrect\n", TEST_FAILED, testName);
+    }
+}
+
 // Test loading positions from file
 void test_dictionary_positions(Dictionary *dict) {
     FILE *file = fopen(TEST_POSITIONS_FILE, "r");
@@ -57,9 +68,10 @@ void test_dictionary_positions(Dictionary *dict) {
             printf("Entry not found in dictionary (as expected for first lookup)\n");
         }
         
-        // Calculate score and insert into dictionary
-        int score = heuristic(LookupTableNew(), &cb, dict);
+        // Calculate score and insert into dictionary, the heuristic itself keeps out of it
+        int score = heuristic(LookupTableNew(), &cb);
         printf("Calculated score: %d\n", score);
+        install_board(dict, &cb, score, depth);
 
         // Verify entry was created
         nlist *newEntry = lookup_board(dict, &cb);
@@ -87,6 +99,9 @@ void test_dictionary_positions(Dictionary *dict) {
 // Test identical positions with different depths
 void test_identical_positions(Dictionary *dict) {
     printf("\n=== Testing Dictionary with Identical Positions at Different Depths ===\n");
+
+    // Start a new search so the entries below may replace deeper ones left by earlier tests
+    age_dictionary(dict);
     
     // Standard starting position
     char *startPos = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -105,8 +120,8 @@ void test_identical_positions(Dictionary *dict) {
     // Insert with higher depth
     install_board(dict, &cb2, 200, 3);
     
-    // Verify both entries
-    verify_dictionary_entry(dict, &cb1, 100, 1, "Entry at depth 1 still correct");
+    // The position keeps a single entry, which the deeper search replaces
+    verify_dictionary_entry(dict, &cb1, 200, 3, "Entry at depth 1 replaced by depth 3");
     verify_dictionary_entry(dict, &cb2, 200, 3, "Entry at depth 3 correct");
     
     // Try to insert with lower depth (should not override)
@@ -139,7 +154,7 @@ void test_dictionary_persistence() {
     {
         printf("Creating first dictionary instance...\n");
         Dictionary dict;
-        init_dictionary(&dict);
+        init_dictionary(&dict, DEFAULT_HASH_MB);
         
         // Insert test positions
         for (int i = 0; i < 3; i++) {
@@ -157,7 +172,7 @@ void test_dictionary_persistence() {
     {
         printf("Creating second dictionary instance and loading from file...\n");
         Dictionary dict;
-        init_dictionary(&dict);
+        init_dictionary(&dict, DEFAULT_HASH_MB);
         
         // Verify all positions were restored
         for (int i = 0; i < 3; i++) {
@@ -197,7 +212,7 @@ void test_complete_reset_persistence() {
     // First dictionary instance - create and save
     {
         Dictionary dict;
-        init_dictionary(&dict);
+        init_dictionary(&dict, DEFAULT_HASH_MB);
         
         ChessBoard cb = ChessBoardNew(testPosition, testDepth);
         install_board(&dict, &cb, testScore, testDepth);
@@ -217,7 +232,7 @@ void test_complete_reset_persistence() {
     // Second dictionary instance - load and verify
     {
         Dictionary dict;
-        init_dictionary(&dict);
+        init_dictionary(&dict, DEFAULT_HASH_MB);
         
         ChessBoard cb = ChessBoardNew(testPosition, testDepth);
         nlist *entry = lookup_board(&dict, &cb);
@@ -240,6 +255,9 @@ void test_complete_reset_persistence() {
 
 void test_persistence_within_nlist(Dictionary *dict) {
     printf("\n=== Testing Persistence within nlist ===\n");
+
+    // Start a new search so the entries below may replace deeper ones left by earlier tests
+    age_dictionary(dict);
     
     // Create a dictionary and add some entries
     
@@ -257,10 +275,10 @@ void test_persistence_within_nlist(Dictionary *dict) {
     put(dict, key, 100, 3);
 
     //Try inserting new entries with roughly the same key
-    uint64_t testKey1 = key + HASHSIZE;
-    uint64_t testKey2 = key + 2 * HASHSIZE;
-    uint64_t testKey3 = key + HASHSIZE+1;
-    uint64_t testKey4 = key + HASHSIZE-1;
+    uint64_t testKey1 = key + dict->size;
+    uint64_t testKey2 = key + 2 * dict->size;
+    uint64_t testKey3 = key + dict->size+1;
+    uint64_t testKey4 = key + dict->size-1;
 
     //Insert new entries
     put(dict, testKey1, 101, 4);
@@ -269,45 +287,17 @@ void test_persistence_within_nlist(Dictionary *dict) {
     put(dict, testKey4, 104, 7);
 
     // Verify the entries
-    nlist *entry0 = lookup(dict, key);
-    nlist *entry1 = lookup(dict, testKey1);
-    nlist *entry2 = lookup(dict, testKey2);
-    nlist *entry3 = lookup(dict, testKey3);
-    nlist *entry4 = lookup(dict, testKey4);
-
-    if (entry0 && entry0->score == 100 && entry0->depth == 3) {
-        printf("%sEntry 0 found and correct\n", TEST_PASSED);
-    } else {
-        printf("%sEntry 0 not found or incorrect\n", TEST_FAILED);
-    }
-    if (entry1 && entry1->score == 101 && entry1->depth == 4) {
-        printf("%sEntry 1 found and correct\n", TEST_PASSED);
-    } else {
-        printf("%sEntry 1 not found or incorrect\n", TEST_FAILED);
-    }
-    if (entry2 && entry2->score == 102 && entry2->depth == 5) {
-        printf("%sEntry 2 found and correct\n", TEST_PASSED);
-    } else {
-        printf("%sEntry 2 not found or incorrect\n", TEST_FAILED);
-    }
-    if (entry3 && entry3->score == 103 && entry3->depth == 6) {
-        printf("%sEntry 3 found and correct\n", TEST_PASSED);
-    } else {
-        printf("%sEntry 3 not found or incorrect\n", TEST_FAILED);
-    }
-    if (entry4 && entry4->score == 104 && entry4->depth == 7) {
-        printf("%sEntry 4 found and correct\n", TEST_PASSED);
-    } else {
-        printf("%sEntry 4 not found or incorrect\n", TEST_FAILED);
-    }
+    verify_key_entry(dict, key, 100, 3, "Entry 0 found and correct");
+    verify_key_entry(dict, testKey1, 101, 4, "Entry 1 found and correct");
+    verify_key_entry(dict, testKey2, 102, 5, "Entry 2 found and correct");
+    verify_key_entry(dict, testKey3, 103, 6, "Entry 3 found and correct");
+    verify_key_entry(dict, testKey4, 104, 7, "Entry 4 found and correct");
 }
 
-// Add additional test to verify binary search tree properties
-void test_binary_tree_properties(Dictionary *dict) {
-    printf("\n=== Testing Binary Tree Properties ===\n");
+// Test that sequential keys, which land in neighbouring buckets, are all retrievable
+void test_sequential_keys(Dictionary *dict) {
+    printf("\n=== Testing Sequential Keys ===\n");
     
-    // Generate a sequence of keys that would create an unbalanced tree 
-    // if inserted in order
     uint64_t keys[10];
     int scores[10];
     int depths[10];
@@ -318,9 +308,6 @@ void test_binary_tree_properties(Dictionary *dict) {
         depths[i] = i + 1;
     }
     
-    // Insert keys in order
-    unsigned hashval = hash(keys[0]);  // All keys will hash to the same bucket
-    
     for (int i = 0; i < 10; i++) {
         put(dict, keys[i], scores[i], depths[i]);
         printf("Inserted key %lu with score %d and depth %d\n", 
@@ -331,9 +318,9 @@ void test_binary_tree_properties(Dictionary *dict) {
     for (int i = 0; i < 10; i++) {
         nlist *entry = lookup(dict, keys[i]);
         if (entry && entry->key == keys[i] && entry->score == scores[i] && entry->depth == depths[i]) {
-            printf("%sSuccessfully found key %lu in BST\n", TEST_PASSED, keys[i]);
+            printf("%sSuccessfully found key %lu\n", TEST_PASSED, keys[i]);
         } else {
-            printf("%sFailed to find key %lu in BST\n", TEST_FAILED, keys[i]);
+            printf("%sFailed to find key %lu\n", TEST_FAILED, keys[i]);
         }
     }
     
@@ -346,17 +333,57 @@ void test_binary_tree_properties(Dictionary *dict) {
     }
 }
 
+// Test that a full bucket evicts its shallowest entry, and prefers entries from older searches
+void test_bucket_replacement(Dictionary *dict) {
+    printf("\n=== Testing Bucket Replacement ===\n");
+
+    uint64_t baseKey = 54321;
+    uint64_t keys[BUCKET_SIZE + 1];
+    for (int i = 0; i <= BUCKET_SIZE; i++) {
+        keys[i] = baseKey + i * dict->size; // Same bucket
+    }
+
+    // Fill the bucket, the first key being the shallowest
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        put(dict, keys[i], 500 + i, 10 + i);
+    }
+    put(dict, keys[BUCKET_SIZE], 600, 12);
+
+    if (lookup(dict, keys[0]) == NULL && lookup(dict, keys[BUCKET_SIZE]) != NULL) {
+        printf("%sShallowest entry evicted from full bucket\n", TEST_PASSED);
+    } else {
+        printf("%sShallowest entry not evicted from full bucket\n", TEST_FAILED);
+    }
+
+    // After a new search starts, shallower entries of the new search replace the deeper old ones
+    age_dictionary(dict);
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        put(dict, baseKey + (BUCKET_SIZE + 1 + i) * dict->size, 700 + i, 8);
+    }
+    int remaining = 0;
+    for (int i = 1; i <= BUCKET_SIZE; i++) {
+        if (lookup(dict, keys[i]) != NULL) {
+            remaining++;
+        }
+    }
+    if (remaining == 0) {
+        printf("%sEntries from an older search replaced first\n", TEST_PASSED);
+    } else {
+        printf("%s%d entries from an older search survived\n", TEST_FAILED, remaining);
+    }
+}
+
 // Test collision handling
 void test_hash_collisions(Dictionary *dict) {
     printf("\n=== Testing Hash Collision Handling ===\n");
     
     // Create keys that hash to the same value but are different
     uint64_t baseKey = 12345;
-    unsigned hashval = hash(baseKey);
-    uint64_t collisionKey = baseKey + HASHSIZE;  // Will hash to same value
+    unsigned hashval = hash(dict, baseKey);
+    uint64_t collisionKey = baseKey + dict->size;  // Will hash to same value
     
     // Verify they hash to the same value
-    if (hash(baseKey) == hash(collisionKey)) {
+    if (hash(dict, baseKey) == hash(dict, collisionKey)) {
         printf("Keys %lu and %lu hash to the same value %u\n", baseKey, collisionKey, hashval);
     } else {
         printf("ERROR: Keys don't hash to the same value\n");
@@ -379,7 +406,6 @@ void test_hash_collisions(Dictionary *dict) {
     
     // Verify both keys are stored and retrievable
     entry1 = lookup(dict, baseKey);
-    nlist *entry2 = lookup(dict, collisionKey);
     
     if (entry1 && entry1->key == baseKey && entry1->score == 100 && entry1->depth == 3) {
         printf("%sAfter collision, baseKey still retrieved correctly\n", TEST_PASSED);
@@ -387,6 +413,7 @@ void test_hash_collisions(Dictionary *dict) {
         printf("%sAfter collision, baseKey not retrieved correctly\n", TEST_FAILED);
     }
     
+    nlist *entry2 = lookup(dict, collisionKey);
     if (entry2 && entry2->key == collisionKey && entry2->score == 200 && entry2->depth == 4) {
         printf("%sCollisionKey stored and retrieved correctly\n", TEST_PASSED);
     } else {
@@ -394,22 +421,21 @@ void test_hash_collisions(Dictionary *dict) {
     }
     
     // Insert a few more keys to the same hash bucket
-    uint64_t collisionKey2 = baseKey + 2 * HASHSIZE;
-    uint64_t collisionKey3 = baseKey + 3 * HASHSIZE;
+    uint64_t collisionKey2 = baseKey + 2 * dict->size;
+    uint64_t collisionKey3 = baseKey + 3 * dict->size;
     
     put(dict, collisionKey2, 300, 5);
     put(dict, collisionKey3, 400, 6);
     
     // Verify all keys are still retrievable
     nlist *entry3 = lookup(dict, collisionKey2);
-    nlist *entry4 = lookup(dict, collisionKey3);
-    
     if (entry3 && entry3->key == collisionKey2 && entry3->score == 300 && entry3->depth == 5) {
         printf("%sCollisionKey2 stored and retrieved correctly\n", TEST_PASSED);
     } else {
         printf("%sCollisionKey2 not stored/retrieved correctly\n", TEST_FAILED);
     }
     
+    nlist *entry4 = lookup(dict, collisionKey3);
     if (entry4 && entry4->key == collisionKey3 && entry4->score == 400 && entry4->depth == 6) {
         printf("%sCollisionKey3 stored and retrieved correctly\n", TEST_PASSED);
     } else {
@@ -417,6 +443,33 @@ void test_hash_collisions(Dictionary *dict) {
     }
 }
 
+// Test that bounds and best moves are stored alongside the score
+void test_bound_and_move(Dictionary *dict) {
+    printf("\n=== Testing Bounds and Best Moves ===\n");
+
+    ChessBoard cb = ChessBoardNew("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 0 1", 4);
+    Move move = MOVE_NEW(62, 45, MOVE_NORMAL); // g1f3
+
+    age_dictionary(dict);
+    install_bound(dict, &cb, -35, 4, BOUND_LOWER, move);
+    nlist *entry = lookup_board(dict, &cb);
+    if (entry && entry->score == -35 && entry->bound == BOUND_LOWER &&
+        entry->move == move) {
+        printf("%sLower bound and best move stored\n", TEST_PASSED);
+    } else {
+        printf("%sLower bound and best move not stored\n", TEST_FAILED);
+    }
+
+    // A later search that found no best move keeps the stored one
+    install_bound(dict, &cb, -50, 5, BOUND_UPPER, MOVE_NULL);
+    entry = lookup_board(dict, &cb);
+    if (entry && entry->score == -50 && entry->bound == BOUND_UPPER && entry->move == move) {
+        printf("%sUpper bound stored and best move kept\n", TEST_PASSED);
+    } else {
+        printf("%sUpper bound not stored or best move lost\n", TEST_FAILED);
+    }
+}
+
 void delete_dictionary_file() {
     // Delete the dictionary file if it exists
     if (remove(DICT_FILENAME) == 0) {
@@ -435,7 +488,7 @@ int main() {
     
     // Test 1: Basic dictionary operations
     Dictionary dict;
-    init_dictionary(&dict);
+    init_dictionary(&dict, DEFAULT_HASH_MB);
     
     printf("Testing basic dictionary functionality...\n");
     test_dictionary_positions(&dict);
@@ -446,22 +499,28 @@ int main() {
     printf("\nTesting persistence within nlist...\n");
     test_persistence_within_nlist(&dict);
     
-    // Test binary tree specific properties
-    test_binary_tree_properties(&dict);
+    // Test keys spread over neighbouring buckets
+    test_sequential_keys(&dict);
     
-    // Test hash collision handling in binary tree
+    // Test hash collision handling within a bucket
     test_hash_collisions(&dict);
+
+    // Test depth and age based replacement
+    test_bucket_replacement(&dict);
+
+    // Test bound types and best moves
+    test_bound_and_move(&dict);
     
     printf("\nSaving dictionary to file...\n");
     exit_dictionary(&dict);
     
     // Test 2: Dictionary persistence after load
-    init_dictionary(&dict);
+    init_dictionary(&dict, DEFAULT_HASH_MB);
     printf("\nTesting dictionary persistence after reload...\n");
     test_dictionary_positions(&dict);
     
-    // Test binary tree properties again after reload
-    test_binary_tree_properties(&dict);
+    // Test bucket properties again after reload
+    test_sequential_keys(&dict);
     test_hash_collisions(&dict);
     
     exit_dictionary(&dict);
@@ -58,7 +58,7 @@ int main(int argc, char *argv[]) {
         ChessBoard board = ChessBoardNew(fen, 0);
 
         // Compute the heuristic score
-        int computedScore = heuristic(lookup, &board, NULL);
+        int computedScore = heuristic(lookup, &board);
 
         // Compare with the expected score
         total++;
@@ -0,0 +1,137 @@
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "Branch.h"
+#include "MoveOrder.h"
+#include "See.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+
+#define TEST_POSITIONS_FILE "src/data/testPositions.in"
+#define TEST_PASSED "✓ PASSED: "
+#define TEST_FAILED "✗ FAILED: "
+
+void test_move_picker(void);
+static int checkPosition(LookupTable l, ChessBoard *cb);
+static int checkPicker(LookupTable l, ChessBoard *cb, MoveList *legal, MoveOrder *mo, Move ttMove);
+
+int main(int argc  __attribute__((unused)), char **argv __attribute__((unused))){
+    test_move_picker();
+    return 0;
+}
+
+// Every position of the perft file and each position one move after it is checked with every legal move as the TT move
+void test_move_picker(void) {
+    printf("Testing the move picker\n");
+    LookupTable l = LookupTableNew();
+    FILE *file = fopen(TEST_POSITIONS_FILE, "r");
+    if (file == NULL) {
+        printf("%sFailed to open %s\n", TEST_FAILED, TEST_POSITIONS_FILE);
+        LookupTableFree(l);
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        // Strip the depth and node count following the FEN
+        line[strcspn(line, "\n")] = 0;
+        if (line[0] == 0) {
+            continue;
+        }
+        for (int i = 0; i < 2; i++) {
+            char *last = strrchr(line, ' ');
+            if (last != NULL) {
+                *last = 0;
+            }
+        }
+
+        ChessBoard cb = ChessBoardNew(line, 0);
+        MoveList legal;
+        BranchLegalMoves(l, &cb, &legal);
+        int errors = checkPosition(l, &cb);
+        for (int i = 0; i < legal.size; i++) {
+            ChessBoard child;
+            ChessBoardPlayMove(&child, &cb, legal.moves[i]);
+            errors += checkPosition(l, &child);
+        }
+
+        if (errors == 0) {
+            printf("%sMove picker order in %s\n", TEST_PASSED, line);
+        } else {
+            printf("%sMove picker order in %s - %d errors\n", TEST_FAILED, line, errors);
+        }
+    }
+
+    fclose(file);
+    LookupTableFree(l);
+}
+
+// Runs the picker without a TT move and then with each legal move as the TT move, killers being the first two quiet moves
+static int checkPosition(LookupTable l, ChessBoard *cb) {
+    MoveList legal;
+    BranchLegalMoves(l, cb, &legal);
+
+    MoveOrder *mo = malloc(sizeof(MoveOrder));
+    MoveOrderClear(mo);
+    int killers = 0;
+    for (int i = 0; i < legal.size && killers < 2; i++) {
+        if (!MoveOrderIsTactical(cb, legal.moves[i])) {
+            mo->killers[0][killers++] = legal.moves[i];
+        }
+    }
+
+    int errors = checkPicker(l, cb, &legal, mo, MOVE_NULL);
+    for (int i = 0; i < legal.size; i++) {
+        errors += checkPicker(l, cb, &legal, mo, legal.moves[i]);
+    }
+    free(mo);
+    return errors;
+}
+
+/*
+ * The picker must hand out every legal move exactly once, the TT move first and the captures
+ * not losing material before any quiet move
+ */
+static int checkPicker(LookupTable l, ChessBoard *cb, MoveList *legal, MoveOrder *mo, Move ttMove) {
+    bool inCheck = ChessBoardChecking(l, cb) != EMPTY_BOARD;
+    MovePicker picker;
+    MovePickerInit(&picker, l, cb, mo, ttMove, 0, inCheck);
+
+    int errors = 0;
+    if (MovePickerCount(&picker) != legal->size) {
+        errors++;
+    }
+
+    int seen[MOVES_SIZE] = {0};
+    int picked = 0;
+    bool quietSeen = false;
+    Move move;
+    while (MovePickerNext(&picker, &move)) {
+        int index = -1;
+        for (int i = 0; i < legal->size; i++) {
+            if (legal->moves[i] == move) {
+                index = i;
+            }
+        }
+        if (index < 0 || seen[index]++ > 0) {
+            errors++; // Illegal or handed out twice
+        }
+        if (picked == 0 && !ChessBoardIsNullMove(ttMove) && move != ttMove) {
+            errors++;
+        }
+        if (move != ttMove) {
+            if (!MoveOrderIsTactical(cb, move)) {
+                quietSeen = true;
+            } else if (quietSeen && SeeEvaluate(l, cb, move) >= 0) {
+                errors++; // Good capture after a quiet move
+            }
+        }
+        picked++;
+    }
+    if (picked != legal->size) {
+        errors++;
+    }
+    return errors;
+}
@@ -0,0 +1,50 @@
+#include "BitBoard.h"
+#include "LookupTable.h"
+#include "ChessBoard.h"
+#include "Branch.h"
+#include "See.h"
+#include "ChessBoardHelper.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+
+#define TEST_PASSED "✓ PASSED: "
+#define TEST_FAILED "✗ FAILED: "
+
+void test_see_positions(void);
+static void checkSee(LookupTable l, char *fen, const char *move, int expected, const char *name);
+
+int main(int argc  __attribute__((unused)), char **argv __attribute__((unused))){
+    test_see_positions();
+    return 0;
+}
+
+// Each exchange is worked out by hand with the values of See.c: pawn 100, knight and bishop 300, rook 500, queen 900
+void test_see_positions(void) {
+    printf("Testing static exchange evaluation\n");
+    LookupTable l = LookupTableNew();
+
+    checkSee(l, "4k3/8/8/3p4/4P3/8/8/4K3 w - - 0 1", "e4d5", 100, "Undefended pawn won");
+    checkSee(l, "4k3/8/2p5/3n4/4P3/8/8/4K3 w - - 0 1", "e4d5", 200, "Knight defended by a pawn won by a pawn");
+    checkSee(l, "4k3/8/2p5/3p4/8/8/8/3QK3 w - - 0 1", "d1d5", -800, "Queen lost to a pawn defending a pawn");
+    checkSee(l, "3rk3/8/8/3p4/8/8/8/3RK3 w - - 0 1", "d1d5", -400, "Rook lost to a rook defending a pawn");
+    checkSee(l, "3rk3/8/8/3p4/8/8/3R4/3RK3 w - - 0 1", "d2d5", 100, "Rook behind a rook recaptures through it");
+    checkSee(l, "3rk3/8/8/3p4/8/8/3R4/3QK3 w - - 0 1", "d2d5", 100, "Queen behind a rook recaptures through it");
+    checkSee(l, "3rk3/3r4/8/3p4/8/8/3R4/3RK3 w - - 0 1", "d2d5", -400, "Defending rooks x-ray as well");
+    checkSee(l, "4k3/8/8/3p4/8/8/8/Q3K3 w - - 0 1", "a1d4", 0, "Quiet move to a safe square");
+    checkSee(l, "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 100, "En passant wins the pawn");
+    checkSee(l, "4k3/2p5/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 0, "En passant traded for the recapturing pawn");
+
+    LookupTableFree(l);
+}
+
+static void checkSee(LookupTable l, char *fen, const char *move, int expected, const char *name) {
+    ChessBoard cb = ChessBoardNew(fen, 0);
+    int see = SeeEvaluate(l, &cb, parseMove(move, &cb));
+    if (see == expected) {
+        printf("%s%s\n", TEST_PASSED, name);
+    } else {
+        printf("%s%s - Found: %d (expected: %d) for %s in %s\n", TEST_FAILED, name, see, expected, move, fen);
+    }
+}
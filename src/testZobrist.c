@@ -2,15 +2,24 @@
 #include "LookupTable.h"
 #include "ChessBoard.h"
 #include "Zobrist.h"
+#include "Branch.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <string.h>
 
+#define TEST_PASSED "✓ PASSED: "
+#define TEST_FAILED "✗ FAILED: "
+
 void test_zobrist_from_file(const char *filename);
+void test_incremental_hash(const char *filename, int depth);
+void test_repetitions(void);
+static int checkIncrementalHash(LookupTable l, ChessBoard *cb, Zobrist_Table *table, int depth);
 
 int main(int argc  __attribute__((unused)), char **argv __attribute__((unused))){
     test_zobrist_from_file("src/data/ZobristTestPosition.in");
+    test_incremental_hash("src/data/ZobristTestPosition.in", 3);
+    test_repetitions();
     return 0;  
 }
 
@@ -40,3 +49,102 @@ void test_zobrist_from_file(const char *filename) {
     free_zobrist(zobrist_table);
 }
 
+// Plays every move sequence up to depth and compares the hash kept by the board with a full recomputation
+void test_incremental_hash(const char *filename, int depth) {
+    printf("Testing incremental Zobrist hash\n");
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror("Failed to open file");
+        return;
+    }
+
+    LookupTable l = LookupTableNew();
+    Zobrist_Table *zobrist_table = init_zobrist();
+    char line[256];
+
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = 0;
+
+        ChessBoard cb = ChessBoardNew(line, depth);
+        int mismatches = checkIncrementalHash(l, &cb, zobrist_table, depth);
+        if (mismatches == 0) {
+            printf("%sIncremental hash of %s\n", TEST_PASSED, line);
+        } else {
+            printf("%sIncremental hash of %s - %d mismatches\n", TEST_FAILED, line, mismatches);
+        }
+    }
+
+    fclose(file);
+    free_zobrist(zobrist_table);
+    LookupTableFree(l);
+}
+
+static int checkIncrementalHash(LookupTable l, ChessBoard *cb, Zobrist_Table *table, int depth) {
+    int mismatches = cb->hash != get_zobrist_hash(cb, table);
+    if (depth == 0) {
+        return mismatches;
+    }
+
+    Branch branches[BRANCHES_SIZE];
+    int branchesSize = BranchFill(l, cb, branches);
+    Move moves[MOVES_SIZE];
+    int movesSize = BranchExtract(branches, branchesSize, moves);
+    for (int i = 0; i < movesSize; i++) {
+        Undo undo;
+        ChessBoardMakeMove(cb, moves[i], &undo);
+        mismatches += checkIncrementalHash(l, cb, table, depth - 1);
+        ChessBoardUnmakeMove(cb, &undo);
+        mismatches += cb->hash != get_zobrist_hash(cb, table);
+    }
+    return mismatches;
+}
+
+static void checkRepetitions(ChessBoard *cb, int expected, const char *name) {
+    int repetitions = ChessBoardRepetitions(cb);
+    if (repetitions == expected) {
+        printf("%s%s\n", TEST_PASSED, name);
+    } else {
+        printf("%s%s - Found: %d (expected: %d)\n", TEST_FAILED, name, repetitions, expected);
+    }
+}
+
+// Both sides move a knight out and back, the hash history has to see the starting position come back
+void test_repetitions(void) {
+    ChessBoard cb = ChessBoardNew("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 7 1", 0);
+    GameHistory history;
+    cb.history = &history;
+    if (cb.halfmove_clock == 7) {
+        printf("%sHalfmove clock read from the FEN\n", TEST_PASSED);
+    } else {
+        printf("%sHalfmove clock read from the FEN - Found: %d (expected: 7)\n", TEST_FAILED, cb.halfmove_clock);
+    }
+
+    Move shuffle[4] = {MOVE_NEW(62, 45, MOVE_NORMAL), MOVE_NEW(6, 21, MOVE_NORMAL), MOVE_NEW(45, 62, MOVE_NORMAL), MOVE_NEW(21, 6, MOVE_NORMAL)}; // g1f3 g8f6 f3g1 f6g8
+    Undo undo;
+    checkRepetitions(&cb, 0, "No repetition at the start");
+    for (int i = 0; i < 4; i++) {
+        ChessBoardMakeMove(&cb, shuffle[i], &undo);
+    }
+    checkRepetitions(&cb, 1, "Position repeated once");
+    for (int i = 0; i < 4; i++) {
+        ChessBoardMakeMove(&cb, shuffle[i], &undo);
+    }
+    checkRepetitions(&cb, 2, "Position repeated twice");
+    if (cb.halfmove_clock == 15) {
+        printf("%sHalfmove clock counts knight moves\n", TEST_PASSED);
+    } else {
+        printf("%sHalfmove clock counts knight moves - Found: %d (expected: 15)\n", TEST_FAILED, cb.halfmove_clock);
+    }
+
+    ChessBoardMakeMove(&cb, MOVE_NEW(52, 44, MOVE_NORMAL), &undo); // e2e3
+    ChessBoardUnmakeMove(&cb, &undo);
+    checkRepetitions(&cb, 2, "Unmake restores the halfmove clock");
+
+    // The pawn move resets the clock, the knights then come back to the position after it
+    ChessBoardMakeMove(&cb, MOVE_NEW(52, 44, MOVE_NORMAL), &undo);
+    Move reply[4] = {shuffle[1], shuffle[0], shuffle[3], shuffle[2]};
+    for (int i = 0; i < 4; i++) {
+        ChessBoardMakeMove(&cb, reply[i], &undo);
+    }
+    checkRepetitions(&cb, 1, "Repetition counted since the last pawn move");
+}
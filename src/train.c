@@ -24,15 +24,21 @@ static int checkGameOver(ChessBoard *cb, LookupTable l);
 
 static int legalMove(char *moveStr, ChessBoard *cb, LookupTable l);
 
+
 void clean_lookups(int sig);
 
 ChessBoard *cb;
 LookupTable l;
 Dictionary dict;
 OpeningBook *openingBook;
+int threads;
+int hashMb;
 
-int main(int argc  __attribute__((unused)), char **argv __attribute__((unused)))
+int main(int argc, char **argv)
 {
+    threads = parseOption(argc, argv, "--threads", 1);
+    hashMb = parseOption(argc, argv, "--hash", DEFAULT_HASH_MB);
+
     struct sigaction sa;
     sa.sa_handler = clean_lookups;
     sa.sa_flags = 0;
@@ -46,7 +52,7 @@ int main(int argc  __attribute__((unused)), char **argv __attribute__((unused)))
     /* ChessBoard cb = ChessBoardNew("4k3/8/8/8/8/1r6/r7/6K1 b - - 0 1", 2); */
 
     
-    init_dictionary(&dict);
+    init_dictionary(&dict, hashMb);
     l = LookupTableNew();
     openingBook = OpeningBookNew(l, ChessBoardNew("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 2));
     OpeningBookGenerate(openingBook, 6);
@@ -60,7 +66,7 @@ static void runGame(ChessBoard *cbinit)
 
     cb->depth = 2;
     ChessBoardPrintBoard(*cb); 
-    Move aiMove = bestMove(l, cb, &dict, -1, TIME_LIMIT, 1, true);
+    Move aiMove = bestMove(l, cb, &dict, -1, TimeControlFixed(TIME_LIMIT), 1, true, threads, NULL);
     
     cb = OpeningBookNext(openingBook);
     if (cb == NULL) {